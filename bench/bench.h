@@ -0,0 +1,34 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "chip8.h"
+#include "benchmark/benchmark.h"
+
+// the engine is the first argument of every benchmark, 0 is the
+// interpreter (the threaded one when built with it) and 1 the jit
+inline bool setEngine(benchmark::State& state, chip8& emu)
+{
+  chip8::Engine engine = state.range(0) == 1 ?
+    chip8::Engine::Jit : chip8::Engine::Interpreter;
+
+  if (!emu.setEngine(engine)) {
+    state.SkipWithError("engine not supported on this host");
+    return false;
+  }
+  return true;
+}
+
+// instructions run per second of wall time
+inline void reportInstructions(benchmark::State& state, double instructions)
+{
+  state.counters["ips"] =
+    benchmark::Counter(instructions, benchmark::Counter::kIsRate);
+}
+
+// runs a benchmark once per engine, use as ->Apply(engines)
+inline void engines(benchmark::internal::Benchmark* b)
+{
+  b->ArgName("engine")->Arg(0)->Arg(1);
+}
+
+#endif /* BENCH_H */
@@ -0,0 +1,69 @@
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "movie.h"
+
+namespace {
+
+const unsigned long frames = 600;
+
+// plays a game for ten seconds of emulated time, pressing the game's keys
+// one after another for 20 frames each with 10 frames of rest in between
+void runGame(benchmark::State& state, const std::string& game,
+  const std::vector<int>& keys)
+{
+  std::ifstream file(std::string(GAMES_DIR) + game, std::ios::binary);
+  std::vector<std::uint8_t> rom((std::istreambuf_iterator<char>(file)),
+    std::istreambuf_iterator<char>());
+
+  chip8 emu;
+  if (!setEngine(state, emu))
+    return;
+
+  unsigned int cyclesPerFrame = emu.getCyclesPerFrame();
+  Movie movie;
+  movie.start(rom.data(), rom.size(), 1, cyclesPerFrame);
+  for (unsigned long frame = 0; frame < frames; frame++) {
+    bool held = frame % 30 < 20;
+    int key = keys[frame / 30 % keys.size()];
+    movie.record(frame * cyclesPerFrame, held ? 1 << key : 0);
+  }
+  movie.finish(frames * cyclesPerFrame);
+
+  MoviePlayer player(movie);
+  for (auto _ : state) {
+    player.begin(emu, rom.data(), rom.size());
+    benchmark::DoNotOptimize(player.run(emu));
+  }
+
+  double runs = static_cast<double>(state.iterations());
+  reportInstructions(state, runs * movie.length);
+
+  // wall time per emulated frame
+  state.counters["frame"] = benchmark::Counter(runs * frames,
+    benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+}
+
+void BM_Pong2(benchmark::State& state)
+{
+  runGame(state, "pong2.c8", {0x1, 0x4});
+}
+BENCHMARK(BM_Pong2)->Apply(engines);
+
+void BM_Tetris(benchmark::State& state)
+{
+  runGame(state, "tetris.c8", {0x4, 0x5, 0x6, 0x7});
+}
+BENCHMARK(BM_Tetris)->Apply(engines);
+
+void BM_Invaders(benchmark::State& state)
+{
+  runGame(state, "invaders.c8", {0x4, 0x5, 0x6});
+}
+BENCHMARK(BM_Invaders)->Apply(engines);
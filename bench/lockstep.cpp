@@ -0,0 +1,91 @@
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "lockstep.h"
+
+namespace {
+
+// ten seconds of emulated time without input, each lane seeded apart so
+// the lanes part ways wherever the game rolls a random number
+const unsigned long cycles = 600 * 10;
+
+std::vector<std::uint8_t> readGame(const std::string& game)
+{
+  std::ifstream file(std::string(GAMES_DIR) + game, std::ios::binary);
+  return std::vector<std::uint8_t>((std::istreambuf_iterator<char>(file)),
+    std::istreambuf_iterator<char>());
+}
+
+// one lane after another on the interpreter, the baseline for the lanes
+// below
+void runScalar(benchmark::State& state, const std::string& game)
+{
+  std::vector<std::uint8_t> rom = readGame(game);
+  unsigned int lanes = state.range(0);
+
+  chip8 emu;
+  for (auto _ : state)
+    for (unsigned int l = 0; l < lanes; l++) {
+      emu.seed(l);
+      emu.loadGame(rom.data(), rom.size());
+      benchmark::DoNotOptimize(emu.runCycles(cycles, chip8::EVENT_NONE));
+    }
+
+  reportInstructions(state,
+    static_cast<double>(state.iterations()) * lanes * cycles);
+}
+
+template<unsigned int N>
+void runLanes(benchmark::State& state, const std::string& game)
+{
+  std::vector<std::uint8_t> rom = readGame(game);
+
+  Lockstep<N> machines;
+  for (unsigned int l = 0; l < N; l++)
+    machines.seed(l, l);
+
+  for (auto _ : state) {
+    machines.loadGame(rom.data(), rom.size());
+    machines.runCycles(cycles);
+    benchmark::DoNotOptimize(machines);
+  }
+
+  reportInstructions(state,
+    static_cast<double>(state.iterations()) * N * cycles);
+}
+
+}
+
+void BM_ScalarTetris(benchmark::State& state)
+{
+  runScalar(state, "tetris.c8");
+}
+BENCHMARK(BM_ScalarTetris)->ArgName("lanes")->Arg(8)->Arg(16)->Arg(32);
+
+template<unsigned int N>
+void BM_LockstepTetris(benchmark::State& state)
+{
+  runLanes<N>(state, "tetris.c8");
+}
+BENCHMARK_TEMPLATE(BM_LockstepTetris, 8);
+BENCHMARK_TEMPLATE(BM_LockstepTetris, 16);
+BENCHMARK_TEMPLATE(BM_LockstepTetris, 32);
+
+void BM_ScalarInvaders(benchmark::State& state)
+{
+  runScalar(state, "invaders.c8");
+}
+BENCHMARK(BM_ScalarInvaders)->ArgName("lanes")->Arg(8)->Arg(16)->Arg(32);
+
+template<unsigned int N>
+void BM_LockstepInvaders(benchmark::State& state)
+{
+  runLanes<N>(state, "invaders.c8");
+}
+BENCHMARK_TEMPLATE(BM_LockstepInvaders, 8);
+BENCHMARK_TEMPLATE(BM_LockstepInvaders, 16);
+BENCHMARK_TEMPLATE(BM_LockstepInvaders, 32);
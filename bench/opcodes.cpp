@@ -0,0 +1,116 @@
+#include <cstdint>
+#include <vector>
+
+#include "bench.h"
+
+namespace {
+
+// a program that runs setup once and then loops over body, repeated to
+// fill most of the memory so the jump back is rare
+std::vector<std::uint8_t> loop(const std::vector<std::uint16_t>& setup,
+  const std::vector<std::uint16_t>& body)
+{
+  std::vector<std::uint16_t> program(setup);
+  std::uint16_t start = 0x200 + setup.size() * 2;
+  while (program.size() + body.size() < 0x580)
+    program.insert(program.end(), body.begin(), body.end());
+  program.push_back(0x1000 | start);
+
+  std::vector<std::uint8_t> rom;
+  for (std::uint16_t opcode : program) {
+    rom.push_back(opcode >> 8);
+    rom.push_back(opcode & 0xFF);
+  }
+  return rom;
+}
+
+const unsigned long cycles = 1 << 16;
+
+void runLoop(benchmark::State& state, const std::vector<std::uint8_t>& rom)
+{
+  chip8 emu;
+  if (!setEngine(state, emu))
+    return;
+  emu.loadGame(rom.data(), rom.size());
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(emu.runCycles(cycles, chip8::EVENT_NONE));
+
+  reportInstructions(state, static_cast<double>(state.iterations()) * cycles);
+}
+
+// memory from 0xE00 on is left for FX33 and FX55 to write to, away from
+// the code
+const std::uint16_t data = 0xAE00;
+
+// a subroutine that returns right away, at 0x204
+const std::vector<std::uint16_t> subroutine = {data, 0x1206, 0x00EE};
+
+}
+
+// a mix of cheap instructions, mostly measuring the dispatch itself
+void BM_Dispatch(benchmark::State& state)
+{
+  runLoop(state, loop({data},
+    {0x6005, 0x7101, 0x8210, 0x3300, 0xA300, 0x8124, 0x4201, 0xF11E}));
+}
+BENCHMARK(BM_Dispatch)->Apply(engines);
+
+// one benchmark per opcode family, set up so no instruction skips
+void BM_Opcode(benchmark::State& state, const std::vector<std::uint16_t>& body)
+{
+  runLoop(state, loop({data}, body));
+}
+BENCHMARK_CAPTURE(BM_Opcode, CLS,      {0x00E0})->Apply(engines);
+BENCHMARK_CAPTURE(BM_Opcode, SE_VX_NN, {0x3001})->Apply(engines);
+BENCHMARK_CAPTURE(BM_Opcode, LD_VX_NN, {0x6042})->Apply(engines);
+BENCHMARK_CAPTURE(BM_Opcode, ADD_VX_NN, {0x7001})->Apply(engines);
+BENCHMARK_CAPTURE(BM_Opcode, ALU,
+  {0x8011, 0x8012, 0x8013, 0x8014, 0x8015, 0x8016, 0x8017, 0x801E})
+  ->Apply(engines);
+BENCHMARK_CAPTURE(BM_Opcode, LD_I_NNN, {0xAE00})->Apply(engines);
+BENCHMARK_CAPTURE(BM_Opcode, RND,      {0xC0FF})->Apply(engines);
+BENCHMARK_CAPTURE(BM_Opcode, SKP,      {0xE09E})->Apply(engines);
+BENCHMARK_CAPTURE(BM_Opcode, TIMERS,   {0xF015, 0xF007})->Apply(engines);
+BENCHMARK_CAPTURE(BM_Opcode, BCD,      {0xF033})->Apply(engines);
+BENCHMARK_CAPTURE(BM_Opcode, LD_I_VX,  {0xFF55, 0xFF65})->Apply(engines);
+
+void BM_CallRet(benchmark::State& state)
+{
+  runLoop(state, loop(subroutine, {0x2204}));
+}
+BENCHMARK(BM_CallRet)->Apply(engines);
+
+// a sprite of the given height, out of the font at address 0
+void BM_Draw(benchmark::State& state)
+{
+  std::uint16_t draw = 0xD010 | state.range(1);
+  runLoop(state, loop({0xA000, 0x6008, 0x6104}, {draw}));
+}
+BENCHMARK(BM_Draw)->ArgNames({"engine", "height"})
+  ->ArgsProduct({{0, 1}, {1, 5, 10, 15}});
+
+void BM_GetGfxBuffer(benchmark::State& state)
+{
+  // a screen full of sprites
+  std::vector<std::uint8_t> rom = loop({0xA000}, {0xD015, 0x7008});
+  chip8 emu;
+  emu.loadGame(rom.data(), rom.size());
+  emu.runCycles(0x400, chip8::EVENT_NONE);
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(emu.getGfxBuffer());
+}
+BENCHMARK(BM_GetGfxBuffer);
+
+void BM_ToBytes(benchmark::State& state)
+{
+  chip8::GfxMem gfx;
+  gfx.fill(0x5555555555555555);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(gfx);
+    benchmark::DoNotOptimize(chip8::toBytes(gfx));
+  }
+}
+BENCHMARK(BM_ToBytes);
@@ -0,0 +1,161 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+
+BatchRunner::BatchRunner(unsigned int threads) :
+  threads(threads)
+{
+  if (this->threads == 0)
+    this->threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+void BatchRunner::run(const std::vector<BatchJob>& jobs,
+  const ResultFn& onResult)
+{
+  if (jobs.empty())
+    return;
+
+#ifndef NDEBUG
+  // the jobs run concurrently and a profiler has no lock
+  std::set<const Profiler*> profilers;
+  for (const BatchJob& job : jobs)
+    assert(!job.profiler || profilers.insert(job.profiler).second);
+#endif
+
+  unsigned int count = std::min<std::size_t>(threads, jobs.size());
+
+  // every thread starts with a contiguous share of the jobs and works
+  // through it from the back, thieves take from the front
+  struct Queue
+  {
+    std::mutex lock;
+    std::deque<std::size_t> jobs;
+  };
+  std::vector<std::unique_ptr<Queue>> queues;
+  for (unsigned int i = 0; i < count; i++)
+    queues.emplace_back(new Queue());
+  for (std::size_t i = 0; i < jobs.size(); i++)
+    queues[i * count / jobs.size()]->jobs.push_back(i);
+
+  std::mutex resultLock;
+
+  auto work = [&](unsigned int self) {
+    for (;;) {
+      std::size_t job = 0;
+      bool found = false;
+
+      {
+        Queue& own = *queues[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.jobs.empty()) {
+          job = own.jobs.back();
+          own.jobs.pop_back();
+          found = true;
+        }
+      }
+
+      for (unsigned int i = 1; i < count && !found; i++) {
+        Queue& victim = *queues[(self + i) % count];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.jobs.empty()) {
+          job = victim.jobs.front();
+          victim.jobs.pop_front();
+          found = true;
+        }
+      }
+
+      // jobs never create more jobs, so once every queue is empty there
+      // is nothing left to do
+      if (!found)
+        return;
+
+      BatchResult result = runJob(jobs[job]);
+      result.job = job;
+
+      std::lock_guard<std::mutex> guard(resultLock);
+      onResult(result);
+    }
+  };
+
+  // the calling thread takes part as well
+  std::vector<std::thread> pool;
+  for (unsigned int i = 1; i < count; i++)
+    pool.emplace_back(work, i);
+  work(0);
+
+  for (auto& thread : pool)
+    thread.join();
+}
+
+BatchResult BatchRunner::runJob(const BatchJob& job)
+{
+  BatchResult result = BatchResult();
+
+  std::unique_ptr<chip8> emu(new chip8());
+  emu->seed(job.seed);
+  result.loaded = job.rom && emu->loadGame(job.rom->data(), job.rom->size());
+  if (!result.loaded ||
+      (job.cycles == 0 && job.frames == 0 && job.stopOn == 0))
+    return result;
+
+  if (job.cyclesPerFrame > 0)
+    emu->setCyclesPerFrame(job.cyclesPerFrame);
+  emu->setEngine(job.engine);
+  emu->setProfiler(job.profiler);
+
+  std::uint64_t screen = chip8::frameHash(chip8::GfxMem());
+  auto next = job.input.begin();
+
+  while ((job.cycles == 0 || result.cycles < job.cycles) &&
+         (job.frames == 0 || result.frames < job.frames))
+  {
+    // press the keys of every input event that is due
+    for (; next != job.input.end() && next->cycle <= result.cycles; ++next) {
+      std::array<std::uint8_t, 16> keys;
+      for (int i = 0; i < 16; i++)
+        keys[i] = (next->keys >> i) & 1;
+      emu->setKeys(keys);
+    }
+
+    // run to the end of the frame, the next input event or the budget,
+    // whichever comes first
+    unsigned long cycles = emu->getCyclesPerFrame();
+    if (job.cycles > 0)
+      cycles = std::min(cycles, job.cycles - result.cycles);
+    if (next != job.input.end())
+      cycles = std::min<unsigned long>(cycles, next->cycle - result.cycles);
+
+    chip8::RunResult run = emu->runCycles(cycles,
+      chip8::EVENT_FRAME | chip8::EVENT_ILLEGAL | job.stopOn);
+    result.cycles += run.cycles;
+    result.events |= run.events;
+
+    if (run.events & chip8::EVENT_FRAME) {
+      ++result.frames;
+
+      // the screen only has to be hashed again when it changed
+      if (emu->takeDirtyRows() != 0) {
+        ++result.draws;
+        screen = chip8::frameHash(emu->getGfxBuffer());
+      }
+      if (job.frameHashes)
+        result.frameHashes.push_back(screen);
+    }
+
+    // execution never gets past an illegal opcode, the events in stopOn
+    // end the run where they happen
+    if (run.events & (chip8::EVENT_ILLEGAL | job.stopOn))
+      break;
+  }
+
+  result.illegalOpcode = emu->illegalOpcode;
+  result.stateHash = emu->stateHash();
+  result.stats = emu->getStats();
+  return result;
+}
@@ -0,0 +1,70 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "chip8.h"
+#include "movie.h"
+
+class Profiler;
+
+// one headless run of a rom. the run ends once either budget is used up,
+// a budget of 0 is no limit, when an illegal opcode is hit or when one of
+// the events in stopOn happens
+struct BatchJob
+{
+  std::shared_ptr<const std::vector<std::uint8_t>> rom;
+  std::vector<InputEvent> input;  // sorted by cycle
+  unsigned long cycles;
+  unsigned long frames;
+  unsigned int cyclesPerFrame;
+  chip8::Engine engine;
+  std::uint64_t seed;             // for the random numbers of CXNN
+  bool frameHashes;               // report a hash of the screen every frame
+  std::uint8_t stopOn;            // chip8::Event flags
+  Profiler* profiler;             // not owned, profiles the run when set.
+                                  // not synchronized, so one per job
+};
+
+struct BatchResult
+{
+  std::size_t job;                // index into the submitted jobs
+  bool loaded;                    // false if the rom did not fit
+  std::uint64_t stateHash;
+  unsigned long cycles;
+  unsigned long frames;
+  unsigned long draws;            // frames in which the screen changed
+  std::uint8_t events;            // every event seen during the run
+  bool illegalOpcode;
+  std::vector<std::uint64_t> frameHashes;
+  chip8::Stats stats;             // all zero unless built with CHIP8_STATS
+};
+
+// runs jobs on a pool of threads. each thread works through its own share
+// of the jobs and steals from the others once it runs dry
+class BatchRunner
+{
+public:
+  typedef std::function<void(const BatchResult&)> ResultFn;
+
+  // 0 threads is one per core
+  BatchRunner(unsigned int threads = 0);
+
+  // runs every job and returns once all are done. results are handed to
+  // onResult as jobs finish, one at a time, in no particular order. no two
+  // jobs may share a profiler
+  void run(const std::vector<BatchJob>& jobs, const ResultFn& onResult);
+
+  unsigned int threadCount() const { return threads; }
+
+  static BatchResult runJob(const BatchJob&);
+
+private:
+  unsigned int threads;
+};
+
+#endif /* BATCH_H */
@@ -0,0 +1,32 @@
+#include "buzzer.h"
+
+#include <algorithm>
+
+Buzzer::Buzzer(Queue& queue, unsigned int sampleRate) :
+  queue(queue)
+{
+  initialize(1, sampleRate);
+}
+
+// the streaming thread must not call onGetData() on a half destroyed
+// object
+Buzzer::~Buzzer()
+{
+  stop();
+}
+
+bool Buzzer::onGetData(Chunk& data)
+{
+  std::size_t count = queue.pop(chunk.data(), chunk.size());
+  std::fill(chunk.begin() + count, chunk.end(), 0);
+
+  data.samples     = chunk.data();
+  data.sampleCount = chunk.size();
+
+  // the stream never ends on its own
+  return true;
+}
+
+void Buzzer::onSeek(sf::Time)
+{
+}
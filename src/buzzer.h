@@ -0,0 +1,31 @@
+#ifndef BUZZER_H
+#define BUZZER_H
+
+#include <array>
+#include <cstdint>
+
+#include <SFML/Audio.hpp>
+
+#include "spscqueue.h"
+
+// plays the samples the emulation thread queues, in chunks of a few
+// milliseconds. silence fills in whenever the queue runs dry
+class Buzzer : public sf::SoundStream
+{
+public:
+  typedef SpscQueue<std::int16_t, 4096> Queue;
+
+  Buzzer(Queue& queue, unsigned int sampleRate);
+  ~Buzzer();
+
+private:
+  bool onGetData(Chunk& data) override;
+  void onSeek(sf::Time) override;
+
+  Queue& queue;
+
+  // 256 samples are 5.8 ms at 44.1 kHz
+  std::array<std::int16_t, 256> chunk;
+};
+
+#endif /* BUZZER_H */
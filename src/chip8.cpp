@@ -1,23 +1,186 @@
 #include "chip8.h"
+#include "fnv.h"
+#include "jit.h"
+#include "profiler.h"
 
 #include <algorithm>
 #include <cstdlib>
-#include <ctime>
+#include <cstring>
 #include <fstream>
 #include <iterator>
 #include <ios>
+#include <map>
 #include <string>
+#include <vector>
 
-chip8::chip8()
+// font set - constains the sprites for drawing characters
+const std::array<std::uint8_t, 80> chip8::chip8_fontset{{
+  0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+  0x20, 0x60, 0x20, 0x20, 0x70, // 1
+  0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+  0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+  0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+  0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+  0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+  0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+  0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+  0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+  0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+  0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+  0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+  0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+  0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+  0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+}};
+
+const std::array<OpcodeWrapper, 0x10000> chip8::dispatchTable =
+  chip8::buildDispatchTable();
+
+const std::array<OpcodeWrapper, chip8::HANDLERS> chip8::handlers{{
+  &chip8::CLS,    &chip8::RET,    &chip8::JP_A,   &chip8::CALL,
+  &chip8::SE_VB,  &chip8::SNE_VB, &chip8::SE_VV,  &chip8::LD_VB,
+  &chip8::ADD_VB, &chip8::LD_VV,  &chip8::OR,     &chip8::AND,
+  &chip8::XOR,    &chip8::ADD_VV, &chip8::SUB_VV, &chip8::SHR,
+  &chip8::SUBN,   &chip8::SHL,    &chip8::SNE_VV, &chip8::LD_IA,
+  &chip8::JP_VA,  &chip8::RND,    &chip8::DRW,    &chip8::SKP,
+  &chip8::SKNP,   &chip8::LD_VDT, &chip8::LD_VK,  &chip8::LD_DTV,
+  &chip8::LD_STV, &chip8::ADD_IV, &chip8::LD_FV,  &chip8::LD_BV,
+  &chip8::LD_IV,  &chip8::LD_VI,  &chip8::ILLEGAL
+}};
+
+const std::array<const char*, chip8::HANDLERS> chip8::handlerNames{{
+  "CLS",    "RET",    "JP_A",   "CALL",
+  "SE_VB",  "SNE_VB", "SE_VV",  "LD_VB",
+  "ADD_VB", "LD_VV",  "OR",     "AND",
+  "XOR",    "ADD_VV", "SUB_VV", "SHR",
+  "SUBN",   "SHL",    "SNE_VV", "LD_IA",
+  "JP_VA",  "RND",    "DRW",    "SKP",
+  "SKNP",   "LD_VDT", "LD_VK",  "LD_DTV",
+  "LD_STV", "ADD_IV", "LD_FV",  "LD_BV",
+  "LD_IV",  "LD_VI",  "ILLEGAL"
+}};
+
+#ifdef CHIP8_STATS
+const bool chip8::statsEnabled = true;
+#else
+const bool chip8::statsEnabled = false;
+#endif
+
+#ifdef CHIP8_STATS
+const std::array<std::uint8_t, 0x10000> chip8::handlerIndex =
+  chip8::buildHandlerIndex();
+
+std::array<std::uint8_t, 0x10000> chip8::buildHandlerIndex()
+{
+  std::array<std::uint8_t, 0x10000> index;
+  for (unsigned int opcode = 0; opcode < index.size(); opcode++)
+    index[opcode] = std::find(handlers.begin(), handlers.end(),
+      dispatchTable[opcode]) - handlers.begin();
+  return index;
+}
+#endif
+
+std::array<OpcodeWrapper, 0x10000> chip8::buildDispatchTable()
+{
+  // bit masks with each position in the array
+  // corresponding to the first byte of the opcode
+  const std::array<std::uint16_t, 16> masks{{
+    0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 0xFF
+  }};
+
+  // function list
+  const std::array<std::map<std::uint16_t, OpcodeWrapper>, 16> opcodes{{
+    // 0x00..
+    {
+      {0x00, &chip8::CLS},
+      {0x0E, &chip8::RET}
+    },
+    // 0x1000
+    { {0x00, &chip8::JP_A} },
+    // 0x2000
+    { {0x00, &chip8::CALL} },
+    // 0x3000
+    { {0x00, &chip8::SE_VB} },
+    // 0x4000
+    { {0x00, &chip8::SNE_VB} },
+    // 0x5000
+    { {0x00, &chip8::SE_VV} },
+    // 0x6000
+    { {0x00, &chip8::LD_VB} },
+    // 0x7000
+    { {0x00, &chip8::ADD_VB} },
+    // 0x800.
+    {
+      {0x00, &chip8::LD_VV},
+      {0x01, &chip8::OR},
+      {0x02, &chip8::AND},
+      {0x03, &chip8::XOR},
+      {0x04, &chip8::ADD_VV},
+      {0x05, &chip8::SUB_VV},
+      {0x06, &chip8::SHR},
+      {0x07, &chip8::SUBN},
+      {0x0E, &chip8::SHL}
+    },
+    // 0x9000
+    { {0x00, &chip8::SNE_VV} },
+    // 0xA000
+    { {0x00, &chip8::LD_IA} },
+    // 0xB000
+    { {0x00, &chip8::JP_VA} },
+    // 0xC000
+    { {0x00, &chip8::RND} },
+    // 0xD000
+    { {0x00, &chip8::DRW} },
+    // 0xE0..
+    {
+      {0x01, &chip8::SKNP},
+      {0x0E, &chip8::SKP}
+    },
+    // 0xF0..
+    {
+      {0x07, &chip8::LD_VDT},
+      {0x0A, &chip8::LD_VK},
+      {0x15, &chip8::LD_DTV},
+      {0x18, &chip8::LD_STV},
+      {0x1E, &chip8::ADD_IV},
+      {0x29, &chip8::LD_FV},
+      {0x33, &chip8::LD_BV},
+      {0x55, &chip8::LD_IV},
+      {0x65, &chip8::LD_VI}
+    }
+  }};
+
+  // resolve every opcode once, so that dispatch is a single table lookup
+  std::array<OpcodeWrapper, 0x10000> table;
+  for (std::uint32_t opcode = 0; opcode < table.size(); ++opcode) {
+    std::uint16_t a = (opcode & 0xF000) >> 12;
+    auto it = opcodes[a].find(opcode & masks[a]);
+    table[opcode] = (it != opcodes[a].end()) ? it->second : &chip8::ILLEGAL;
+  }
+
+  return table;
+}
+
+chip8::chip8() :
+  memory(),
+  decoded(),
+  rngSeed(0),
+  shownGfx(),
+  cyclesPerFrame(10),
+  profiler(nullptr),
+  stats()
 {
   reset();
-  std::srand(std::time(0));
+}
+
+chip8::~chip8()
+{
 }
 
 bool chip8::loadGame(const std::string& filename)
 {
   if (filename == "") return false;
-  reset();
 
   std::ifstream file(filename, std::ios::binary | std::ios::ate);
   if (!file.is_open()) return false;
@@ -28,23 +191,48 @@ bool chip8::loadGame(const std::string& filename)
     return false;
 
   file.seekg(0);
-  auto start = std::istreambuf_iterator<char>(file);
-  auto end = std::istreambuf_iterator<char>();
+  std::vector<std::uint8_t> rom((std::istreambuf_iterator<char>(file)),
+    std::istreambuf_iterator<char>());
 
-  std::copy(start, end, memory.begin() + 512);
+  return loadGame(rom.data(), rom.size());
+}
 
+bool chip8::loadGame(const std::uint8_t* data, std::size_t size)
+{
+  if (size > memory.size() - 512)
+    return false;
+
+  restart(data, size);
   return true;
 }
 
 void chip8::emulateCycle()
 {
-  // get current opcode
-  std::uint16_t opcode = (memory[pc] << 8) | memory[pc + 1];
+#ifdef CHIP8_THREADED
+  runThreaded(1, EVENT_NONE);
+#else
+  // fetch the decoded instruction, decoding it on first use. pc wraps
+  // around the end of memory like I does
+  const Instruction& in = decoded[pc & 0xFFF];
+  if (in.fn == nullptr)
+    decode(pc & 0xFFF);
+
+#ifdef CHIP8_STATS
+  ++stats.executed[in.handler];
+#endif
 
   // handle opcode
-  std::uint16_t a = (opcode & 0xF000) >> 12;
-  OpcodeWrapper fn = this->opcodes[a][(opcode & masks[a])];
-  (this->*fn)(opcode);
+  (this->*in.fn)(in);
+
+  if (++frameCycle == cyclesPerFrame)
+    endFrame();
+#endif
+}
+
+void chip8::endFrame()
+{
+  frameCycle = 0;
+  events |= EVENT_FRAME;
 
   // handle sound timers
   if (delay_timer > 0)
@@ -56,24 +244,254 @@ void chip8::emulateCycle()
       beep = true;
     --sound_timer;
   }
+}
+
+chip8::RunResult chip8::runCycles(unsigned long cycles, std::uint8_t stopOn)
+{
+  events = EVENT_NONE;
+
+  unsigned long done = 0;
+  if (profiler) {
+    done = runProfiled(cycles, stopOn);
+  } else if (jit) {
+    done = jit->run(cycles, stopOn);
+  } else {
+#ifdef CHIP8_THREADED
+    done = runThreaded(cycles, stopOn);
+#else
+    while (done < cycles) {
+      emulateCycle();
+      ++done;
+      if (events & stopOn)
+        break;
+    }
+#endif
+  }
 
+  RunResult result{done, events};
+  return result;
+}
+
+// one instruction at a time, so the profiler sees every pc
+unsigned long chip8::runProfiled(unsigned long cycles, std::uint8_t stopOn)
+{
+  unsigned long done = 0;
+  while (done < cycles) {
+    std::uint16_t addr = pc;
+    emulateCycle();
+    profiler->record(addr, sp, pc);
+    ++done;
+    if (events & stopOn)
+      break;
+  }
+
+  return done;
+}
+
+void chip8::setProfiler(Profiler* profiler)
+{
+  this->profiler = profiler;
+}
+
+chip8::RunResult chip8::runUntilFrame(std::uint8_t stopOn)
+{
+  return runCycles(cyclesPerFrame - frameCycle, stopOn | EVENT_FRAME);
+}
+
+void chip8::setCyclesPerFrame(unsigned int cycles)
+{
+  cyclesPerFrame = std::max(cycles, 1u);
+  if (frameCycle >= cyclesPerFrame)
+    frameCycle = 0;
+}
+
+unsigned int chip8::getCyclesPerFrame() const
+{
+  return cyclesPerFrame;
+}
+
+bool chip8::setEngine(Engine engine)
+{
+  if (engine == Engine::Interpreter) {
+    jit.reset();
+    return true;
+  }
+
+  if (!engineSupported(engine))
+    return false;
+  if (!jit)
+    jit.reset(new Jit(*this));
+  return true;
+}
+
+chip8::Engine chip8::getEngine() const
+{
+  return jit ? Engine::Jit : Engine::Interpreter;
+}
+
+bool chip8::engineSupported(Engine engine)
+{
+  return engine == Engine::Interpreter || Jit::supported();
 }
 
 void chip8::reset()
 {
+  restart(nullptr, 0);
+}
+
+// resets the machine with the rom loaded. reloading a rom keeps whatever
+// the engines have decoded of it
+void chip8::restart(const std::uint8_t* rom, std::size_t size)
+{
+  std::array<std::uint8_t, 4096> image = {{}};
+  std::copy(chip8_fontset.begin(), chip8_fontset.end(), image.begin());
+  std::copy(rom, rom + size, image.begin() + 512);
+  replaceMemory(image);
+
   drawFlag    = true;
   gfx         = {{}};
+  dirtyRows   = ~0u;
   I           = 0;
   pc          = 0x200;
   sp          = 0;
   delay_timer = 0;
   sound_timer = 0;
+  frameCycle  = 0;
   stack       = {{}};
-  memory      = {{}};
   V           = {{}};
   key         = {{}};
+  rng         = rngState(rngSeed);
+
+  illegalOpcode = false;
+  events        = EVENT_NONE;
+}
+
+// the seed is spread over all bits with splitmix64, xorshift must not
+// start from 0
+std::uint64_t chip8::rngState(std::uint64_t seed)
+{
+  std::uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z ^= z >> 31;
+  return z != 0 ? z : 1;
+}
+
+// takes effect immediately and on every reset()
+void chip8::seed(std::uint64_t value)
+{
+  rngSeed = value;
+  rng     = rngState(value);
+}
+
+const std::uint16_t chip8::SaveState::VERSION;
+
+void chip8::saveState(SaveState& state) const
+{
+  state.magic          = {{'S', 'C', '8', 'E'}};
+  state.version        = SaveState::VERSION;
+  state.I              = I;
+  state.pc             = pc;
+  state.sp             = sp;
+  state.delay_timer    = delay_timer;
+  state.sound_timer    = sound_timer;
+  state.beep           = beep;
+  state.illegalOpcode  = illegalOpcode;
+  state.frameCycle     = frameCycle;
+  state.cyclesPerFrame = cyclesPerFrame;
+  state.stack          = stack;
+  state.memory         = memory;
+  state.V              = V;
+  state.key            = key;
+  state.gfx            = gfx;
+  state.rng            = rng;
+}
+
+bool chip8::loadState(const SaveState& state)
+{
+  if (state.magic != std::array<char, 4>{{'S', 'C', '8', 'E'}} ||
+      state.version != SaveState::VERSION ||
+      state.cyclesPerFrame == 0 || state.rng == 0)
+    return false;
+
+  // pc, I and sp can hold any value, every use wraps them into range
+
+  replaceMemory(state.memory);
+
+  I              = state.I;
+  pc             = state.pc;
+  sp             = state.sp;
+  delay_timer    = state.delay_timer;
+  sound_timer    = state.sound_timer;
+  beep           = state.beep;
+  illegalOpcode  = state.illegalOpcode;
+  cyclesPerFrame = state.cyclesPerFrame;
+  frameCycle     = state.frameCycle % cyclesPerFrame;
+  stack          = state.stack;
+  V              = state.V;
+  key            = state.key;
+  gfx            = state.gfx;
+  rng            = state.rng;
+
+  drawFlag  = true;
+  dirtyRows = ~0u;
+  events    = EVENT_NONE;
+
+  return true;
+}
+
+// only the instructions that actually changed have to be decoded again,
+// equal blocks are skipped with a fast compare first
+void chip8::replaceMemory(const std::array<std::uint8_t, 4096>& image)
+{
+  const unsigned int block = 64;
+  for (unsigned int b = 0; b < memory.size(); b += block) {
+    if (std::memcmp(&memory[b], &image[b], block) == 0)
+      continue;
+
+    for (unsigned int i = b; i < b + block; ++i)
+      if (memory[i] != image[i])
+        invalidate(i, 1);
+  }
+
+  memory = image;
+}
+
+void chip8::invalidate(std::uint16_t addr, std::uint16_t len)
+{
+  // writes wrap around the end of memory, and so do the ranges
+  addr &= 0xFFF;
+  if (addr + len > memory.size()) {
+    invalidate(0, addr + len - memory.size());
+    len = memory.size() - addr;
+  }
+
+  // an instruction spans two bytes, so the one starting just before the
+  // written range is stale as well
+  unsigned int first = (addr > 0) ? addr - 1 : 0;
+  unsigned int last  = std::min<unsigned int>(addr + len, decoded.size());
+  for (unsigned int i = first; i < last; ++i)
+    decoded[i].fn = nullptr;
+  if (addr == 0)
+    decoded[decoded.size() - 1].fn = nullptr;
 
-  std::copy(chip8_fontset.begin(), chip8_fontset.end(), memory.begin());
+  if (jit)
+    jit->invalidate(addr, len);
+}
+
+void chip8::decode(std::uint16_t addr)
+{
+  std::uint16_t opcode = (memory[addr] << 8) | memory[(addr + 1) & 0xFFF];
+
+  Instruction& in = decoded[addr];
+  in.fn      = dispatchTable[opcode];
+  in.nnn     = (opcode & 0x0FFF);
+  in.x       = (opcode & 0x0F00) >> 8;
+  in.y       = (opcode & 0x00F0) >> 4;
+  in.nn      = (opcode & 0x00FF);
+  in.n       = (opcode & 0x000F);
+  in.handler = std::find(handlers.begin(), handlers.end(), in.fn) -
+    handlers.begin();
 }
 
 void chip8::setKeys(const std::array<std::uint8_t, 16>& keys)
@@ -81,11 +499,92 @@ void chip8::setKeys(const std::array<std::uint8_t, 16>& keys)
   key = keys;
 }
 
+// the buzzer sounds while the sound timer is above 0
+std::uint8_t chip8::getSoundTimer() const
+{
+  return sound_timer;
+}
+
 chip8::GfxMem chip8::getGfxBuffer()
 {
-  gfxMutex.lock();
-  GfxMem buf(gfx);
-  gfxMutex.unlock();
+  return gfx;
+}
 
-  return buf;
+// rows that differ from the screen returned by the previous call. rows
+// drawn and erased again in between are not reported
+std::uint32_t chip8::takeDirtyRows()
+{
+  std::uint32_t changed = 0;
+  for (int y = 0; y < 32; y++) {
+    if (!(dirtyRows & (1u << y)) || gfx[y] == shownGfx[y])
+      continue;
+
+    shownGfx[y] = gfx[y];
+    changed |= 1u << y;
+  }
+
+  dirtyRows = 0;
+  return changed;
+}
+
+// hash of everything that decides how the machine continues, the same on
+// every host and engine
+std::uint64_t chip8::stateHash() const
+{
+  std::uint64_t hash = fnvOffset;
+  fnv(hash, I, 2);
+  fnv(hash, pc, 2);
+  fnv(hash, sp, 2);
+  fnv(hash, delay_timer, 1);
+  fnv(hash, sound_timer, 1);
+  fnv(hash, frameCycle, 4);
+  for (std::uint16_t s : stack)
+    fnv(hash, s, 2);
+  for (std::uint8_t m : memory)
+    fnv(hash, m, 1);
+  for (std::uint8_t v : V)
+    fnv(hash, v, 1);
+  for (std::uint64_t row : gfx)
+    fnv(hash, row, 8);
+  fnv(hash, rng, 8);
+
+  return hash;
+}
+
+std::uint64_t chip8::frameHash(const GfxMem& gfx)
+{
+  std::uint64_t hash = fnvOffset;
+  for (std::uint64_t row : gfx)
+    fnv(hash, row, 8);
+
+  return hash;
+}
+
+chip8::GfxBytes chip8::toBytes(const GfxMem& gfx)
+{
+  GfxBytes bytes;
+  for (int y = 0; y < 32; y++)
+    for (int x = 0; x < 64; x++)
+      bytes[x + y*64] = (gfx[y] >> (63 - x)) & 1;
+
+  return bytes;
+}
+
+const chip8::Stats& chip8::getStats() const
+{
+  return stats;
+}
+
+void chip8::resetStats()
+{
+  stats = Stats();
+}
+
+#ifdef CHIP8_STATS
+// counts the instructions of a straight-line run the jit executed at once
+void chip8::countBlock(std::uint16_t addr, unsigned int length)
+{
+  for (unsigned int i = 0; i < length; i++, addr += 2)
+    ++stats.executed[handlerIndex[(memory[addr] << 8) | memory[addr + 1]]];
 }
+#endif
@@ -2,36 +2,138 @@
 #define CHIP8_H
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
-#include <functional>
-#include <map>
-#include <mutex>
+#include <memory>
 #include <string>
 
 class chip8;
+class Jit;
+class Profiler;
+struct Instruction;
 
-typedef void (chip8::*OpcodeWrapper)(std::uint16_t);
-typedef void Opcode(std::uint16_t);
+typedef void (chip8::*OpcodeWrapper)(const Instruction&);
+
+// an opcode's handler and pre-extracted operands. the layout does not
+// depend on build options, the library and its users have to agree on it
+struct Instruction
+{
+  OpcodeWrapper fn;
+  std::uint16_t nnn;
+  std::uint8_t  x;
+  std::uint8_t  y;
+  std::uint8_t  nn;
+  std::uint8_t  n;
+  std::uint8_t  handler;  // index of fn in handlers
+};
 
 class chip8
 {
 public:
-  using GfxMem = std::array<std::uint8_t, 32 * 64>;
+  // one row per word, pixel x of a row is bit 63 - x
+  using GfxMem = std::array<std::uint64_t, 32>;
+  // one byte per pixel, for consumers that want to index pixels directly
+  using GfxBytes = std::array<std::uint8_t, 32 * 64>;
+
+  // execution engines, the interpreter is the reference
+  enum class Engine { Interpreter, Jit };
+
+  // things happening during a run, as bit flags
+  enum Event : std::uint8_t {
+    EVENT_NONE    = 0,
+    EVENT_DRAW    = 1 << 0, // CLS or DRW changed the screen
+    EVENT_SOUND   = 1 << 1, // LD_STV started or stopped the sound
+    EVENT_KEYWAIT = 1 << 2, // LD_VK is waiting for a key
+    EVENT_ILLEGAL = 1 << 3, // an opcode could not be decoded
+    EVENT_FRAME   = 1 << 4, // the last cycle of a frame was run
+    EVENT_ALL     = 0xFF
+  };
+
+  struct RunResult
+  {
+    unsigned long cycles;  // cycles actually run
+    std::uint8_t  events;  // every event that happened
+  };
+
+  // snapshot of a machine. the layout is fixed and has no padding, so the
+  // bytes only depend on the machine state. multi-byte fields are stored in
+  // host order, which is little endian on every supported host
+  struct SaveState
+  {
+    static const std::uint16_t VERSION = 2;
+
+    std::array<char, 4> magic;  // "SC8E"
+    std::uint16_t version;
+    std::uint16_t I;
+    std::uint16_t pc;
+    std::uint16_t sp;
+    std::uint8_t  delay_timer;
+    std::uint8_t  sound_timer;
+    std::uint8_t  beep;
+    std::uint8_t  illegalOpcode;
+    std::uint32_t frameCycle;
+    std::uint32_t cyclesPerFrame;
+    std::array<std::uint16_t, 16>   stack;
+    std::array<std::uint8_t,  4096> memory;
+    std::array<std::uint8_t,  16>   V;
+    std::array<std::uint8_t,  16>   key;
+    std::array<std::uint64_t, 32>   gfx;
+    std::uint64_t rng;
+  };
+
+  // execution counters, only collected when built with CHIP8_STATS
+  static const unsigned int HANDLERS = 35;
+  struct Stats
+  {
+    std::array<std::uint64_t, HANDLERS> executed;  // as in handlerNames
+    std::uint64_t drawNanoseconds;                 // spent in DRW
+  };
+  static const bool statsEnabled;
+  static const std::array<const char*, HANDLERS> handlerNames;
 
   // functions
   chip8();
+  ~chip8();
   bool loadGame(const std::string&);
+  bool loadGame(const std::uint8_t* data, std::size_t size);
   void emulateCycle();
+
+  // frame ends are always reported, but only stop the run when asked for
+  RunResult runCycles(unsigned long,
+    std::uint8_t stopOn = EVENT_ALL & ~EVENT_FRAME);
+  RunResult runUntilFrame(std::uint8_t stopOn = EVENT_ALL);
+  void setCyclesPerFrame(unsigned int);
+  unsigned int getCyclesPerFrame() const;
+  bool setEngine(Engine);
+  Engine getEngine() const;
+  static bool engineSupported(Engine);
   void reset();
+  void seed(std::uint64_t);
+  void saveState(SaveState&) const;
+  bool loadState(const SaveState&);
   void setKeys(const std::array<std::uint8_t, 16>&);
+  std::uint8_t getSoundTimer() const;
   GfxMem getGfxBuffer();
+  std::uint32_t takeDirtyRows();
+  static GfxBytes toBytes(const GfxMem&);
+  std::uint64_t stateHash() const;
+  static std::uint64_t frameHash(const GfxMem&);
+  const Stats& getStats() const;
+  void resetStats();
 
-  // screen was redrawn
+  // counts every instruction run from now on in profiler, nullptr stops.
+  // while attached every engine steps through the interpreter
+  void setProfiler(Profiler*);
+
+  // screen was redrawn, only meant for the thread running the emulation
   bool drawFlag;
 
   // audio variable
   bool beep;
 
+  // the last opcode could not be decoded, execution is stuck on it
+  bool illegalOpcode;
+
 protected:
   // cpu variables
   std::uint16_t I;
@@ -42,7 +144,11 @@ protected:
   std::uint8_t delay_timer;
   std::uint8_t sound_timer;
 
-  // memory
+  // cycles run in the current frame, the timers count down once per frame
+  unsigned int frameCycle;
+
+  // memory. pc, I and sp are free to run past the end, the addresses and
+  // stack slots they pick wrap around, as does the key a skip looks at
   std::array<std::uint16_t, 16>     stack;
   std::array<std::uint8_t,  4096>   memory;
   std::array<std::uint8_t,  16>     V;
@@ -50,136 +156,128 @@ protected:
   // graphics memory
   GfxMem gfx;
 
+  // rows CLS and DRW wrote to since the last takeDirtyRows(), bit n is
+  // row n. may include rows that ended up unchanged
+  std::uint32_t dirtyRows;
+
+  // decoded instruction for every address, fn is null until first executed.
+  // anything writing to memory has to invalidate() the addresses it touched
+  std::array<Instruction, 4096> decoded;
+  void invalidate(std::uint16_t addr, std::uint16_t len);
+  void replaceMemory(const std::array<std::uint8_t, 4096>&);
+  void decode(std::uint16_t addr);
+
   // input variables
   std::array<std::uint8_t, 16> key;
 
+  // random number generator state, never 0. reset() restarts it from
+  // rngSeed
+  std::uint64_t rng;
+  std::uint64_t rngSeed;
+
+  // xorshift64*, the top byte of the output is the random number
+  static std::uint64_t rngState(std::uint64_t seed);
+  static std::uint8_t random(std::uint64_t& state)
+  {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return (state * 0x2545F4914F6CDD1DULL) >> 56;
+  }
+
+  // a row of sprite bits placed at column x, wrapping around the right
+  // edge of the screen
+  static std::uint64_t spriteRow(std::uint8_t bits, std::uint8_t x)
+  {
+    std::uint64_t row = static_cast<std::uint64_t>(bits) << 56;
+    unsigned int shift = x % 64;
+    return (row >> shift) | (row << ((64 - shift) % 64));
+  }
+
 private:
+  friend class Jit;
+  template<unsigned int> friend class Lockstep;
+
+  // computed goto interpreter, only defined when built with
+  // CHIP8_THREADED, see threaded.cpp
+  unsigned long runThreaded(unsigned long cycles, std::uint8_t stopOn);
+
+  void restart(const std::uint8_t* rom, std::size_t size);
+
   // opcodes
-  void CLS    (std::uint16_t);
-  void RET    (std::uint16_t);
-  void JP_A   (std::uint16_t);
-  void CALL   (std::uint16_t);
-  void SE_VB  (std::uint16_t);
-  void SNE_VB (std::uint16_t);
-  void SE_VV  (std::uint16_t);
-  void LD_VB  (std::uint16_t);
-  void ADD_VB (std::uint16_t);
-  void LD_VV  (std::uint16_t);
-  void OR     (std::uint16_t);
-  void AND    (std::uint16_t);
-  void XOR    (std::uint16_t);
-  void ADD_VV (std::uint16_t);
-  void SUB_VV (std::uint16_t);
-  void SHR    (std::uint16_t);
-  void SUBN   (std::uint16_t);
-  void SHL    (std::uint16_t);
-  void SNE_VV (std::uint16_t);
-  void LD_IA  (std::uint16_t);
-  void JP_VA  (std::uint16_t);
-  void RND    (std::uint16_t);
-  void DRW    (std::uint16_t);
-  void SKP    (std::uint16_t);
-  void SKNP   (std::uint16_t);
-  void LD_VDT (std::uint16_t);
-  void LD_VK  (std::uint16_t);
-  void LD_DTV (std::uint16_t);
-  void LD_STV (std::uint16_t);
-  void ADD_IV (std::uint16_t);
-  void LD_FV  (std::uint16_t);
-  void LD_BV  (std::uint16_t);
-  void LD_IV  (std::uint16_t);
-  void LD_VI  (std::uint16_t);
+  void CLS    (const Instruction&);
+  void RET    (const Instruction&);
+  void JP_A   (const Instruction&);
+  void CALL   (const Instruction&);
+  void SE_VB  (const Instruction&);
+  void SNE_VB (const Instruction&);
+  void SE_VV  (const Instruction&);
+  void LD_VB  (const Instruction&);
+  void ADD_VB (const Instruction&);
+  void LD_VV  (const Instruction&);
+  void OR     (const Instruction&);
+  void AND    (const Instruction&);
+  void XOR    (const Instruction&);
+  void ADD_VV (const Instruction&);
+  void SUB_VV (const Instruction&);
+  void SHR    (const Instruction&);
+  void SUBN   (const Instruction&);
+  void SHL    (const Instruction&);
+  void SNE_VV (const Instruction&);
+  void LD_IA  (const Instruction&);
+  void JP_VA  (const Instruction&);
+  void RND    (const Instruction&);
+  void DRW    (const Instruction&);
+  void SKP    (const Instruction&);
+  void SKNP   (const Instruction&);
+  void LD_VDT (const Instruction&);
+  void LD_VK  (const Instruction&);
+  void LD_DTV (const Instruction&);
+  void LD_STV (const Instruction&);
+  void ADD_IV (const Instruction&);
+  void LD_FV  (const Instruction&);
+  void LD_BV  (const Instruction&);
+  void LD_IV  (const Instruction&);
+  void LD_VI  (const Instruction&);
+  void ILLEGAL(const Instruction&);
 
   // static variables
   // font set - constains the sprites for drawing characters
-  std::array<std::uint8_t, 80> chip8_fontset{{
-    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-    0x20, 0x60, 0x20, 0x20, 0x70, // 1
-    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-    0xF0, 0x80, 0xF0, 0x80, 0x80  // F
-  }};
-
-  std::mutex gfxMutex;
-
-  // bit masks with each position in the array
-  // corresponding to the first byte of the opcode
-  std::array<std::uint16_t, 16> masks{{
-    0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 0xFF
-  }};
-
-  // function list
-  std::array<std::map<std::uint16_t, OpcodeWrapper>, 16> opcodes{{
-    // 0x00..
-    {
-      {0x00, &chip8::CLS},
-      {0x0E, &chip8::RET}
-    },
-    // 0x1000
-    { {0x00, &chip8::JP_A} },
-    // 0x2000
-    { {0x00, &chip8::CALL} },
-    // 0x3000
-    { {0x00, &chip8::SE_VB} },
-    // 0x4000
-    { {0x00, &chip8::SNE_VB} },
-    // 0x5000
-    { {0x00, &chip8::SE_VV} },
-    // 0x6000
-    { {0x00, &chip8::LD_VB} },
-    // 0x7000
-    { {0x00, &chip8::ADD_VB} },
-    // 0x800.
-    {
-      {0x00, &chip8::LD_VV},
-      {0x01, &chip8::OR},
-      {0x02, &chip8::AND},
-      {0x03, &chip8::XOR},
-      {0x04, &chip8::ADD_VV},
-      {0x05, &chip8::SUB_VV},
-      {0x06, &chip8::SHR},
-      {0x07, &chip8::SUBN},
-      {0x0E, &chip8::SHL}
-    },
-    // 0x9000
-    { {0x00, &chip8::SNE_VV} },
-    // 0xA000
-    { {0x00, &chip8::LD_IA} },
-    // 0xB000
-    { {0x00, &chip8::JP_VA} },
-    // 0xC000
-    { {0x00, &chip8::RND} },
-    // 0xD000
-    { {0x00, &chip8::DRW} },
-    // 0xE0..
-    {
-      {0x01, &chip8::SKNP},
-      {0x0E, &chip8::SKP}
-    },
-    // 0xF0..
-    {
-      {0x07, &chip8::LD_VDT},
-      {0x0A, &chip8::LD_VK},
-      {0x15, &chip8::LD_DTV},
-      {0x18, &chip8::LD_STV},
-      {0x1E, &chip8::ADD_IV},
-      {0x29, &chip8::LD_FV},
-      {0x33, &chip8::LD_BV},
-      {0x55, &chip8::LD_IV},
-      {0x65, &chip8::LD_VI}
-    }
-  }};
+  static const std::array<std::uint8_t, 80> chip8_fontset;
+
+  // the screen as of the last takeDirtyRows()
+  GfxMem shownGfx;
+
+  // events raised since the start of the current run
+  std::uint8_t events;
+
+  // instructions per frame, a frame is 1/60 s of emulated time
+  unsigned int cyclesPerFrame;
+  void endFrame();
+
+  // recompiler, only present while the jit engine is selected
+  std::unique_ptr<Jit> jit;
+
+  // not owned, only set while profiling
+  Profiler* profiler;
+  unsigned long runProfiled(unsigned long cycles, std::uint8_t stopOn);
+
+  // handler for every possible opcode, indexed by the opcode itself
+  static const std::array<OpcodeWrapper, 0x10000> dispatchTable;
+  static std::array<OpcodeWrapper, 0x10000> buildDispatchTable();
+
+  // every handler, in the order of handlerNames
+  static const std::array<OpcodeWrapper, HANDLERS> handlers;
+
+  Stats stats;
+
+  // index into handlers for every possible opcode, only defined when built
+  // with CHIP8_STATS
+  static const std::array<std::uint8_t, 0x10000> handlerIndex;
+  static std::array<std::uint8_t, 0x10000> buildHandlerIndex();
+  void countBlock(std::uint16_t addr, unsigned int length);
 };
+static_assert(sizeof(chip8::SaveState) == 4448,
+  "the save state layout must not change without a version bump");
+
 #endif /* CHIP8_H */
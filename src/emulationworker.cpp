@@ -0,0 +1,175 @@
+#include "emulatorcanvas.h"
+
+#include <algorithm>
+
+EmulationWorker::EmulationWorker(int frequency) :
+  TimedWorker(frequency),
+  engine(chip8::Engine::Interpreter),
+  cyclesPerFrame(emu.getCyclesPerFrame()),
+  rewinding(false),
+  speed(1),
+  frameCount(0),
+  cycle(0),
+  recording(false),
+  held(0),
+  pressedAt(),
+  lastTick(0),
+  audible(true),
+  wave(sampleRate, 440, 6000)
+{
+}
+
+void EmulationWorker::restartCycles()
+{
+  cycle = 0;
+  pressedAt.fill(0);
+  applyKeys(~std::uint64_t(0));
+}
+
+void EmulationWorker::tick()
+{
+  std::lock_guard<std::mutex> guard(lock);
+
+  if (emu.getEngine() != engine && !emu.setEngine(engine))
+    engine = emu.getEngine();
+
+  // fast forward runs several frames per tick, unlimited as many as fit
+  // into most of it. only the last frame is shown and only the first
+  // goes into the history
+  unsigned int multiple = speed;
+  std::int64_t now = FrameScheduler::now();
+  std::int64_t end = now + framePeriod() * 3 / 4;
+  takeInput(now);
+  audible = multiple == 1;
+  for (unsigned int i = 0;
+       multiple > 0 ? i < multiple : i == 0 || FrameScheduler::now() < end;
+       i++)
+  {
+    runFrame(i == 0);
+    ++frameCount;
+  }
+
+  std::uint32_t dirty = emu.takeDirtyRows();
+  if (dirty)
+    frames.publish(emu.getGfxBuffer(), dirty);
+}
+
+void EmulationWorker::takeInput(std::int64_t now)
+{
+  std::int64_t start = std::max(lastTick, now - framePeriod());
+  std::int64_t span = std::max<std::int64_t>(now - start, 1);
+  std::uint64_t cycles = emu.getCyclesPerFrame();
+  lastTick = now;
+
+  KeyEvent event;
+  while (input.pop(event)) {
+    std::int64_t offset = std::min(std::max<std::int64_t>(
+      event.time - start, 0), span - 1);
+    KeyChange change = { cycle + offset * cycles / span, event.key,
+      event.pressed };
+    if (change.pressed)
+      pressedAt[change.key] = change.cycle;
+    else
+      change.cycle = std::max(change.cycle, pressedAt[change.key] + cycles);
+
+    // releases held back can end up behind later changes
+    pending.insert(std::upper_bound(pending.begin(), pending.end(), change,
+      [](const KeyChange& a, const KeyChange& b) {
+        return a.cycle < b.cycle;
+      }), change);
+  }
+}
+
+bool EmulationWorker::applyKeys(std::uint64_t upTo)
+{
+  bool changed = false;
+  while (!pending.empty() && pending.front().cycle <= upTo) {
+    std::uint16_t bit = 1 << pending.front().key;
+    held = pending.front().pressed ? held | bit : held & ~bit;
+    pending.pop_front();
+    changed = true;
+  }
+  return changed;
+}
+
+void EmulationWorker::pressKeys()
+{
+  std::array<std::uint8_t, 16> array;
+  for (int i = 0; i < 16; i++)
+    array[i] = (held >> i) & 1;
+  emu.setKeys(array);
+  if (recording)
+    movie.record(cycle, held);
+}
+
+void EmulationWorker::runSplitFrame()
+{
+  unsigned int cyclesPerFrame = emu.getCyclesPerFrame();
+  std::uint8_t stopOn = chip8::EVENT_FRAME |
+    (audible ? chip8::EVENT_SOUND : chip8::EVENT_NONE);
+  bool on = emu.getSoundTimer() > 0;
+  unsigned long done = 0;
+  std::size_t queued = 0;
+
+  for (;;) {
+    chip8::RunResult result;
+    if (player) {
+      result = player->run(emu, stopOn);
+      applyKeys(cycle + result.cycles);
+    } else {
+      if (applyKeys(cycle))
+        pressKeys();
+
+      unsigned long budget = cyclesPerFrame;
+      if (!pending.empty())
+        budget = pending.front().cycle - cycle;
+      result = emu.runCycles(budget, stopOn);
+    }
+    done  += result.cycles;
+    cycle += result.cycles;
+    if ((result.events & chip8::EVENT_FRAME) || (player && player->finished()))
+      break;
+
+    if (audible) {
+      std::size_t upTo = samplesPerFrame * done / cyclesPerFrame;
+      queueSamples(on, upTo - queued);
+      queued = upTo;
+      on = emu.getSoundTimer() > 0;
+    }
+  }
+
+  if (audible)
+    queueSamples(on, samplesPerFrame - queued);
+}
+
+void EmulationWorker::queueSamples(bool on, std::size_t count)
+{
+  std::array<std::int16_t, samplesPerFrame> samples;
+  wave.generate(on, samples.data(), count);
+  if (audio.size() + count <= maxQueued)
+    audio.push(samples.data(), count);
+}
+
+void EmulationWorker::runFrame(bool keep)
+{
+  if (player) {
+    // the movie sets the cycles per frame itself
+    runSplitFrame();
+    if (player->finished())
+      player.reset();
+  } else if (rewinding && !recording) {
+    if (history.pop(state))
+      emu.loadState(state);
+  } else {
+    if (!recording && emu.getCyclesPerFrame() != cyclesPerFrame)
+      emu.setCyclesPerFrame(cyclesPerFrame);
+
+    // a loaded or rewound state brings its own keys
+    pressKeys();
+    runSplitFrame();
+    if (keep) {
+      emu.saveState(state);
+      history.push(state);
+    }
+  }
+}
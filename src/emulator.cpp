@@ -1,3 +1,5 @@
+#include <cstdlib>
+#include <iostream>
 #include <string>
 
 #include <QMainWindow>
@@ -7,18 +9,38 @@
 
 int main(int argc, char* argv[])
 {
+  // qt takes out the arguments it knows
+  QApplication App(argc, argv);
+
+  // where QSettings keeps the settings
+  QApplication::setOrganizationName("SC8E");
+  QApplication::setApplicationName("SC8E");
+
   // parse arguments
   std::string filename;
-  if (argc > 1) {
-    filename = argv[1];
+  int cpu = -1;
+  bool realtime = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--cpu" && i + 1 < argc) {
+      cpu = std::atoi(argv[++i]);
+    } else if (arg == "--realtime") {
+      realtime = true;
+    } else if (arg[0] == '-') {
+      std::cerr << "usage: " << argv[0] << " [--cpu N] [--realtime] [rom]"
+        << std::endl;
+      return 2;
+    } else {
+      filename = arg;
+    }
   }
 
-  QApplication App(argc, argv);
   MainWindow w;
   EmulatorCanvas* emu = w.emu();
+  emu->setSchedulingOptions(cpu, realtime);
 
-  if(!filename.empty())
-    emu->loadFile(filename);
+  if (!filename.empty() && !emu->loadFile(filename))
+    std::cerr << "Could not load " << filename << std::endl;
 
   w.show();
 
@@ -1,30 +1,74 @@
 #include "emulatorcanvas.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
-#include <iostream>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
 
-#include "res/blip.h"
+#include <QKeySequence>
+#include <QSettings>
+#include <QString>
+
+namespace {
+
+// a different seed for every load, even several within one second. chip8
+// spreads it over the generator's state with splitmix64
+std::uint64_t freshSeed()
+{
+  std::random_device device;
+  std::uint64_t seed = (static_cast<std::uint64_t>(device()) << 32) | device();
+  return seed ^ std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+}
 
 EmulatorCanvas::EmulatorCanvas(QWidget* Parent) :
-  QSFMLCanvas(Parent)
+  QSFMLCanvas(Parent),
+  fastForward(false),
+  fastForwardSpeed(8),
+  speedFrames(0),
+  keys(defaultKeyMap()),
+  pressed(0),
+  rewindHeld(false),
+  turboHeld(false)
 {
   worker = new EmulationWorker();
+  speedTimer.start();
   connect(worker, SIGNAL(finished()), worker, SLOT(deleteLater()));
+
+  setColors(sf::Color::Green, sf::Color::Black);
+
+  // keys/0 to keys/f, as the name of the key, e.g. "Q"
+  QSettings settings;
+  for (int i = 0; i < 16; i++) {
+    QKeySequence key(settings.value(QString("keys/%1").arg(i, 0, 16))
+      .toString());
+    if (!key.isEmpty())
+      keys[i] = key[0];
+  }
 }
 
 EmulatorCanvas::~EmulatorCanvas()
 {
-  worker->terminate();
+  worker->stop();
   worker->wait();
 }
 
 bool EmulatorCanvas::loadFile(const std::string& filename)
 {
-  if(worker->emu.loadGame(filename)) {
-    this->filename = filename;
+  std::lock_guard<std::mutex> guard(worker->lock);
+  worker->emu.seed(freshSeed());
+  if (!worker->emu.loadGame(filename))
     return false;
-  }
 
+  worker->history.clear();
+  worker->restartCycles();
+  worker->recording = false;
+  worker->player.reset();
+  this->filename = filename;
   return true;
 }
 
@@ -33,32 +77,250 @@ bool EmulatorCanvas::reloadFile()
   return loadFile(filename);
 }
 
+// states are kept next to the rom as <rom>.state<slot>
+bool EmulatorCanvas::saveState(int slot)
+{
+  if (filename == "") return false;
+
+  chip8::SaveState state;
+  {
+    std::lock_guard<std::mutex> guard(worker->lock);
+    worker->emu.saveState(state);
+  }
+
+  std::ofstream file(filename + ".state" + std::to_string(slot),
+    std::ios::binary);
+  file.write(reinterpret_cast<const char*>(&state), sizeof(state));
+  return file.good();
+}
+
+bool EmulatorCanvas::loadState(int slot)
+{
+  if (filename == "") return false;
+
+  chip8::SaveState state;
+  std::ifstream file(filename + ".state" + std::to_string(slot),
+    std::ios::binary);
+  if (!file.read(reinterpret_cast<char*>(&state), sizeof(state)))
+    return false;
+
+  // a movie can only be played back from the start it was recorded from
+  std::lock_guard<std::mutex> guard(worker->lock);
+  if (worker->recording || worker->player) return false;
+  return worker->emu.loadState(state);
+}
+
+bool EmulatorCanvas::readRom(std::vector<std::uint8_t>& rom) const
+{
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open()) return false;
+
+  rom.assign(std::istreambuf_iterator<char>(file),
+    std::istreambuf_iterator<char>());
+  return true;
+}
+
+// the movie of a rom is kept next to it as <rom>.movie
+bool EmulatorCanvas::startRecording()
+{
+  std::vector<std::uint8_t> rom;
+  if (filename == "" || !readRom(rom)) return false;
+
+  std::lock_guard<std::mutex> guard(worker->lock);
+  std::uint64_t seed = freshSeed();
+  worker->emu.seed(seed);
+  if (!worker->emu.loadGame(rom.data(), rom.size()))
+    return false;
+
+  // the clock rate can not change while recording
+  worker->emu.setCyclesPerFrame(worker->cyclesPerFrame);
+  worker->movie.start(rom.data(), rom.size(), seed,
+    worker->emu.getCyclesPerFrame());
+  worker->history.clear();
+  worker->restartCycles();
+  worker->recording = true;
+  worker->player.reset();
+  return true;
+}
+
+bool EmulatorCanvas::stopRecording()
+{
+  std::lock_guard<std::mutex> guard(worker->lock);
+  if (!worker->recording) return false;
+
+  worker->recording = false;
+  worker->movie.finish(worker->cycle);
+  return worker->movie.save(filename + ".movie");
+}
+
+bool EmulatorCanvas::playMovie()
+{
+  std::vector<std::uint8_t> rom;
+  if (filename == "" || !readRom(rom)) return false;
+
+  std::lock_guard<std::mutex> guard(worker->lock);
+  if (worker->recording || !worker->movie.load(filename + ".movie"))
+    return false;
+
+  worker->player.reset(new MoviePlayer(worker->movie));
+  if (!worker->player->begin(worker->emu, rom.data(), rom.size())) {
+    worker->player.reset();
+    return false;
+  }
+
+  worker->history.clear();
+  worker->restartCycles();
+  return true;
+}
+
 void EmulatorCanvas::setClockRate(unsigned int freq)
 {
-  worker->setFrequency(freq);
+  // the timers always run at 60 Hz, only the instructions per frame change
+  worker->cyclesPerFrame = freq / 60;
+}
+
+void EmulatorCanvas::setSchedulingOptions(int cpu, bool realtime)
+{
+  worker->setAffinity(cpu);
+  worker->setRealtime(realtime);
+}
+
+void EmulatorCanvas::setEngine(chip8::Engine engine)
+{
+  worker->engine = engine;
+}
+
+chip8::Stats EmulatorCanvas::stats()
+{
+  std::lock_guard<std::mutex> guard(worker->lock);
+  return worker->emu.getStats();
+}
+
+void EmulatorCanvas::resetStats()
+{
+  std::lock_guard<std::mutex> guard(worker->lock);
+  worker->emu.resetStats();
+}
+
+void EmulatorCanvas::setFastForward(bool on)
+{
+  fastForward = on;
+}
+
+void EmulatorCanvas::setFastForwardSpeed(unsigned int multiple)
+{
+  fastForwardSpeed = multiple;
 }
 
-void EmulatorCanvas::updateInput()
+double EmulatorCanvas::measureSpeed()
 {
-  // get keys
-  std::array<std::uint8_t, 16> keys;
+  std::uint64_t frames = worker->frameCount;
+  qint64 elapsed = speedTimer.restart();
+  double speed = elapsed > 0 ?
+    (frames - speedFrames) * 1000.0 / elapsed / 60 : 0;
+
+  speedFrames = frames;
+  return speed;
+}
+
+void EmulatorCanvas::setColors(const sf::Color& on, const sf::Color& off)
+{
+  this->on  = on;
+  this->off = off;
+
+  // sf::Color is laid out as the r, g, b, a bytes the texture expects
+  std::memcpy(&onPixel, &on, sizeof(onPixel));
+  std::memcpy(&offPixel, &off, sizeof(offPixel));
+  colorsChanged = true;
+}
+
+EmulatorCanvas::KeyMap EmulatorCanvas::defaultKeyMap()
+{
+  KeyMap keys = {{
+    Qt::Key_1, Qt::Key_2, Qt::Key_3, Qt::Key_Q,
+    Qt::Key_W, Qt::Key_E, Qt::Key_A, Qt::Key_S,
+    Qt::Key_D, Qt::Key_X, Qt::Key_Y, Qt::Key_C,
+    Qt::Key_4, Qt::Key_R, Qt::Key_F, Qt::Key_V
+  }};
+  return keys;
+}
+
+void EmulatorCanvas::setKeyMap(const KeyMap& keys)
+{
+  releaseKeys();
+  this->keys = keys;
+
+  QSettings settings;
   for (int i = 0; i < 16; i++)
-    keys[i] = sf::Keyboard::isKeyPressed(layout[i]);
+    settings.setValue(QString("keys/%1").arg(i, 0, 16),
+      QKeySequence(keys[i]).toString());
+}
+
+void EmulatorCanvas::keyPressEvent(QKeyEvent* event)
+{
+  // the key is already down as far as the emulator is concerned
+  if (event->isAutoRepeat() || !handleKey(event->key(), true))
+    QSFMLCanvas::keyPressEvent(event);
+}
+
+void EmulatorCanvas::keyReleaseEvent(QKeyEvent* event)
+{
+  if (event->isAutoRepeat() || !handleKey(event->key(), false))
+    QSFMLCanvas::keyReleaseEvent(event);
+}
+
+// true if key is one the emulator uses
+bool EmulatorCanvas::handleKey(int key, bool down)
+{
+  if (key == Qt::Key_Backspace) {
+    rewindHeld = down;
+    return true;
+  }
+  if (key == Qt::Key_Tab) {
+    turboHeld = down;
+    return true;
+  }
+
+  std::int64_t now = FrameScheduler::now();
+  for (int i = 0; i < 16; i++) {
+    std::uint16_t bit = 1 << i;
+    if (keys[i] != key || ((pressed & bit) != 0) == down)
+      continue;
+
+    // the queue only fills up if the worker stopped taking input, the
+    // change is lost then and pressed stays as it was
+    KeyEvent event = { now, static_cast<std::uint8_t>(i), down };
+    if (worker->input.push(event))
+      pressed = down ? pressed | bit : pressed & ~bit;
+  }
+  return std::find(keys.begin(), keys.end(), key) != keys.end();
+}
 
-  worker->emu.setKeys(keys);
+// keys released while the canvas has no focus never arrive
+void EmulatorCanvas::releaseKeys()
+{
+  std::int64_t now = FrameScheduler::now();
+  for (int i = 0; i < 16; i++) {
+    std::uint16_t bit = 1 << i;
+    KeyEvent event = { now, static_cast<std::uint8_t>(i), false };
+    if ((pressed & bit) && worker->input.push(event))
+      pressed &= ~bit;
+  }
+  rewindHeld = false;
+  turboHeld = false;
 }
 
 void EmulatorCanvas::OnInit()
 {
-  // graphics
-  shape.setSize(sf::Vector2<float>(10, 10));
-  shape.setFillColor(sf::Color::Green);
+  // graphics, the view is one unit per chip8 pixel and gets stretched
+  // over the whole canvas
+  texture.create(64, 32);
+  sprite.setTexture(texture);
+  render.setView(sf::View(sf::FloatRect(0, 0, 64, 32)));
 
   // sound
-  if (!buffer.loadFromMemory(blip.data(), blip.size()))
-    std::cerr << "Could not load audio resources, continuing without!" << std::endl;
-  else
-    sound.setBuffer(buffer);
+  buzzer.reset(new Buzzer(worker->audio, EmulationWorker::sampleRate));
+  buzzer->play();
 
   worker->start();
 }
@@ -66,28 +328,53 @@ void EmulatorCanvas::OnInit()
 void EmulatorCanvas::OnRepaint()
 {
   worker->paused = !focus;
-  if (!focus) return;
+  if (!focus) {
+    releaseKeys();
+    return;
+  }
 
-  updateInput();
+  // rewind while backspace is held
+  worker->rewinding = rewindHeld;
 
-  // draw
-  if (worker->emu.drawFlag) {
-    worker->emu.drawFlag = false;
+  bool turbo = fastForward || turboHeld;
+  worker->speed = turbo ? fastForwardSpeed : 1;
 
-    render.clear(sf::Color::Black);
+  // expand the rows of the newest frame that changed into the texture
+  std::uint32_t dirty = 0;
+  if (worker->frames.update())
+    dirty = worker->frames.front().dirty;
+  if (colorsChanged) {
+    colorsChanged = false;
+    dirty = ~0u;
+  }
 
-    chip8::GfxMem gfx(worker->emu.getGfxBuffer());
+  if (dirty) {
+    // one upload covering every dirty row
+    int first = 0;
+    int last  = 31;
+    while (!(dirty & (1u << first))) first++;
+    while (!(dirty & (1u << last)))  last--;
+    expandRows(worker->frames.front().gfx, first, last);
+    texture.update(reinterpret_cast<const sf::Uint8*>(&pixels[first * 64]),
+      64, last - first + 1, 0, first);
+  }
 
+  render.clear(off);
+  render.draw(sprite);
+}
+
+void EmulatorCanvas::expandRows(const chip8::GfxMem& gfx, int first, int last)
+{
+  std::uint32_t diff = onPixel ^ offPixel;
+
+  for (int y = first; y <= last; y++) {
+    std::uint64_t row = gfx[y];
+    std::uint32_t* out = &pixels[y * 64];
+
+    // branch free, so the compiler can vectorize it
     for (int x = 0; x < 64; x++) {
-      for (int y = 0; y < 32; y++) {
-        if (gfx[x + y*64]) {
-          shape.setPosition(x*10, y*10);
-          render.draw(shape);
-        }
-      }
+      std::uint32_t mask = -static_cast<std::uint32_t>((row >> (63 - x)) & 1);
+      out[x] = offPixel ^ (diff & mask);
     }
   }
-
-  if (worker->emu.beep)
-    sound.play();
 }
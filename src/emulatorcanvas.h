@@ -2,29 +2,145 @@
 #define EMULATORCANVAS_H
 
 #include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
+#include <QElapsedTimer>
+#include <QKeyEvent>
 #include <QWidget>
 
 #include <SFML/Audio.hpp>
 #include <SFML/Window.hpp>
 #include <SFML/Graphics.hpp>
 
+#include "buzzer.h"
 #include "chip8.h"
+#include "framehandoff.h"
+#include "movie.h"
 #include "qsfmlcanvas.h"
+#include "rewind.h"
+#include "spscqueue.h"
+#include "squarewave.h"
 #include "timedworker.h"
 
+// a chip8 key going down or up, at FrameScheduler::now()
+struct KeyEvent
+{
+  std::int64_t time;
+  std::uint8_t key;
+  bool pressed;
+};
+
 class EmulationWorker : public TimedWorker
 {
   Q_OBJECT
 public:
-  EmulationWorker(int frequency = 60) : TimedWorker(frequency) { }
+  // runs one emulated frame per tick, so frequency is the frame rate at
+  // normal speed
+  EmulationWorker(int frequency = 60);
   chip8 emu;
 
+  // settings requested by the ui, applied on the emulation thread
+  std::atomic<chip8::Engine> engine;
+  std::atomic<unsigned int> cyclesPerFrame;
+
+  // key changes from the ui. every tick takes what arrived since the tick
+  // before and applies it at the cycles of its first frame that match
+  // when the changes happened, so input is a frame late but keeps its
+  // timing within the frame
+  SpscQueue<KeyEvent, 256> input;
+
+  // step back one frame per tick instead of running
+  std::atomic<bool> rewinding;
+
+  // frames per tick, 0 runs as many as the host manages
+  std::atomic<unsigned int> speed;
+
+  // frames run or rewound so far
+  std::atomic<std::uint64_t> frameCount;
+
+  // the state at the end of every frame run, only touched with lock held
+  Rewind history;
+
+  // cycles run since the game was loaded, only touched with lock held
+  std::uint64_t cycle;
+
+  // the input is recorded into movie while recording, and taken from
+  // player instead of keys while player is set
+  bool recording;
+  Movie movie;
+  std::unique_ptr<MoviePlayer> player;
+
+  // completed frames, published by the emulation thread
+  FrameHandoff frames;
+
+  // the buzzer as mono samples, produced by the emulation thread as it
+  // runs frames at normal speed. samples that would queue up for longer
+  // than maxQueued are dropped, so the latency stays bounded: a tone is
+  // heard at most maxQueued plus the three chunks sf::SoundStream keeps
+  // in flight after its frame was run, about 50 ms
+  static const unsigned int sampleRate = 44100;
+  static const std::size_t samplesPerFrame = sampleRate / 60;
+  static const std::size_t maxQueued = 2 * samplesPerFrame;
+  Buzzer::Queue audio;
+
+  // held by the ui while it works on emu directly, e.g. to load a game
+  std::mutex lock;
+
+  // for the ui when it starts counting cycles from 0 again, with lock held.
+  // pending key changes take effect right away
+  void restartCycles();
+
 protected:
-  void tick() override {
-    emu.emulateCycle();
-  }
+  void tick() override;
+
+private:
+  // a key change at the cycle it is applied at
+  struct KeyChange
+  {
+    std::uint64_t cycle;
+    std::uint8_t key;
+    bool pressed;
+  };
+
+  // spreads the key events that arrived since the last tick over the next
+  // frame. a press is held for at least a frame, so games that only look
+  // at the keys once a frame still see short taps
+  void takeInput(std::int64_t now);
+
+  // applies the changes due up to cycle to held, true if any were
+  bool applyKeys(std::uint64_t upTo);
+  void pressKeys();
+
+  // runs a frame in pieces, stopping at every key change that is due and,
+  // when audible, where the program starts or stops the sound so the tone
+  // changes on the sample of that cycle. the timer running out only
+  // happens at the end of a frame. a movie being played presses its keys
+  // at the cycles they were recorded at, the changes from the ui only
+  // update held then
+  void runSplitFrame();
+  void queueSamples(bool on, std::size_t count);
+
+  // runs, replays or rewinds a frame, keeping it in the history if asked
+  void runFrame(bool keep);
+
+  chip8::SaveState state;
+
+  // key changes from input not applied yet, by cycle, and the keys they
+  // left held. only touched with lock held
+  std::deque<KeyChange> pending;
+  std::uint16_t held;
+  std::array<std::uint64_t, 16> pressedAt;
+  std::int64_t lastTick;
+
+  // only frames at normal speed make sound, anything else would pile up
+  bool audible;
+  SquareWave wave;
 };
 
 class EmulatorCanvas : public QSFMLCanvas
@@ -34,47 +150,88 @@ public:
   EmulatorCanvas(QWidget*);
   virtual ~EmulatorCanvas();
 
+  // true when the file was read and the emulator reset onto it
   bool loadFile(const std::string&);
   bool reloadFile();
+  bool saveState(int slot);
+  bool loadState(int slot);
+
+  // movies are recorded from a fresh start of the current rom
+  bool startRecording();
+  bool stopRecording();
+  bool playMovie();
   void setClockRate(unsigned int);
-  void updateInput();
+  void setEngine(chip8::Engine);
+
+  // for the emulation thread, see TimedWorker. only before the canvas is
+  // first shown
+  void setSchedulingOptions(int cpu, bool realtime);
+  chip8::Stats stats();
+  void resetStats();
+  void setColors(const sf::Color& on, const sf::Color& off);
+
+  // fast forward while toggled on or while tab is held, at multiple times
+  // the normal speed, 0 for as fast as possible
+  void setFastForward(bool);
+  void setFastForwardSpeed(unsigned int multiple);
+
+  // emulated frames per 1/60 s since the last call
+  double measureSpeed();
+  const sf::Color& onColor() const { return on; }
+  const sf::Color& offColor() const { return off; }
+
+  // the qt key of each chip8 key, 0 to f, kept in the settings
+  typedef std::array<int, 16> KeyMap;
+  static KeyMap defaultKeyMap();
+  const KeyMap& keyMap() const { return keys; }
+  void setKeyMap(const KeyMap&);
 
 private:
   void OnInit() override;
   void OnRepaint() override;
 
+  void keyPressEvent(QKeyEvent*) override;
+  void keyReleaseEvent(QKeyEvent*) override;
+  bool handleKey(int key, bool down);
+  void releaseKeys();
+
+  // tab is the fast forward key, keep it from moving the focus away
+  bool focusNextPrevChild(bool) override { return false; }
+  void expandRows(const chip8::GfxMem&, int first, int last);
+
   // emulation worker which lives on a separate thread
   EmulationWorker* worker;
 
-  // "sprite" for drawing pixels
-  sf::RectangleShape shape;
+  // the framebuffer as rgba pixels, drawn as a single stretched texture
+  std::array<std::uint32_t, 64 * 32> pixels;
+  sf::Texture texture;
+  sf::Sprite sprite;
+
+  // pixel colours, and the same as rgba words
+  sf::Color on;
+  sf::Color off;
+  std::uint32_t onPixel;
+  std::uint32_t offPixel;
+  bool colorsChanged;
 
-  // audio variables
-  sf::SoundBuffer buffer;
-  sf::Sound sound;
+  // audio, playing worker->audio
+  std::unique_ptr<Buzzer> buzzer;
 
   // rom file name
   std::string filename;
 
-  // input
-  std::array<sf::Keyboard::Key, 16> layout{{
-    sf::Keyboard::Num1,
-    sf::Keyboard::Num2,
-    sf::Keyboard::Num3,
-    sf::Keyboard::Q,
-    sf::Keyboard::W,
-    sf::Keyboard::E,
-    sf::Keyboard::A,
-    sf::Keyboard::S,
-    sf::Keyboard::D,
-    sf::Keyboard::X,
-    sf::Keyboard::Y,
-    sf::Keyboard::C,
-    sf::Keyboard::Num4,
-    sf::Keyboard::R,
-    sf::Keyboard::F,
-    sf::Keyboard::V
-  }};
+  bool fastForward;
+  unsigned int fastForwardSpeed;
+  QElapsedTimer speedTimer;
+  std::uint64_t speedFrames;
+
+  bool readRom(std::vector<std::uint8_t>&) const;
+
+  // input, pressed is what the ui sent to the worker, bit n is key n
+  KeyMap keys;
+  std::uint16_t pressed;
+  bool rewindHeld;
+  bool turboHeld;
 };
 
 #endif /* EMULATORCANVAS_H */
@@ -0,0 +1,19 @@
+#ifndef FNV_H
+#define FNV_H
+
+#include <cstdint>
+
+// 64 bit FNV-1a, fed with values byte by byte from the least significant
+// end so that hashes are the same on every host
+const std::uint64_t fnvOffset = 0xCBF29CE484222325ULL;
+const std::uint64_t fnvPrime  = 0x100000001B3ULL;
+
+inline void fnv(std::uint64_t& hash, std::uint64_t value, int bytes)
+{
+  for (int i = 0; i < bytes; i++) {
+    hash ^= (value >> (i * 8)) & 0xFF;
+    hash *= fnvPrime;
+  }
+}
+
+#endif /* FNV_H */
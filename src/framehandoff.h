@@ -0,0 +1,52 @@
+#ifndef FRAMEHANDOFF_H
+#define FRAMEHANDOFF_H
+
+#include <cstdint>
+
+#include "chip8.h"
+#include "triplebuffer.h"
+
+// a completed frame and the rows that changed since the frame the consumer
+// picked up before it
+struct Frame
+{
+  chip8::GfxMem gfx;
+  std::uint32_t dirty;
+};
+
+// completed frames from the emulation thread to the ui. the rows of
+// frames the ui never picked up are carried over into the next one, however
+// many were replaced in a row
+class FrameHandoff
+{
+public:
+  FrameHandoff() :
+    unshown(0)
+  {
+  }
+
+  // producer side
+  void publish(const chip8::GfxMem& gfx, std::uint32_t dirty)
+  {
+    // a frame still waiting is replaced, so its rows go along. when it is
+    // picked up in between the extra rows are only redrawn unchanged
+    std::uint32_t rows = dirty | (frames.pending() ? unshown : 0);
+    Frame& frame = frames.back();
+    frame.gfx   = gfx;
+    frame.dirty = rows;
+    frames.publish();
+    unshown = rows;
+  }
+
+  // consumer side, see TripleBuffer
+  bool update() { return frames.update(); }
+  const Frame& front() const { return frames.front(); }
+
+private:
+  TripleBuffer<Frame> frames;
+
+  // the rows of the frame published last
+  std::uint32_t unshown;
+};
+
+#endif /* FRAMEHANDOFF_H */
@@ -0,0 +1,93 @@
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <cerrno>
+#include <cstdint>
+#include <time.h>
+
+// paces frames to a fixed frequency. frame n is due at the absolute time
+// origin + n / frequency, so rounding never adds up. a loop that fell
+// behind runs the late frames back to back, but never more than maxLag of
+// them, anything older is dropped. times are nanoseconds of now()
+class FrameScheduler
+{
+public:
+  FrameScheduler(unsigned int frequency, unsigned int maxLag) :
+    frequency(frequency),
+    maxLag(maxLag),
+    origin(0),
+    frame(0),
+    dropped(0)
+  {
+  }
+
+  // the next frame is due at now
+  void restart(std::int64_t now)
+  {
+    origin = now;
+    frame  = 0;
+  }
+
+  // takes effect from the next frame on
+  void setFrequency(unsigned int value)
+  {
+    origin    = deadline(frame);
+    frame     = 0;
+    frequency = value;
+  }
+
+  unsigned int getFrequency() const { return frequency; }
+
+  // when the next frame is due. frames further behind now than maxLag are
+  // dropped first
+  std::int64_t next(std::int64_t now)
+  {
+    if (now >= deadline(frame)) {
+      std::uint64_t last = static_cast<std::uint64_t>(now - origin) *
+        frequency / 1000000000;
+      std::uint64_t behind = last - frame + 1;
+      if (behind > maxLag) {
+        frame   += behind - maxLag;
+        dropped += behind - maxLag;
+      }
+    }
+    return deadline(frame);
+  }
+
+  // the next frame was run
+  void advance() { ++frame; }
+
+  std::int64_t period() const { return 1000000000 / frequency; }
+  std::uint64_t droppedFrames() const { return dropped; }
+
+  static std::int64_t now()
+  {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<std::int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+  }
+
+  static void sleepUntil(std::int64_t time)
+  {
+    timespec ts;
+    ts.tv_sec  = time / 1000000000;
+    ts.tv_nsec = time % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr)
+           == EINTR)
+      ;
+  }
+
+private:
+  std::int64_t deadline(std::uint64_t n) const
+  {
+    return origin + static_cast<std::int64_t>(n * 1000000000 / frequency);
+  }
+
+  unsigned int frequency;
+  unsigned int maxLag;
+  std::int64_t origin;
+  std::uint64_t frame;
+  std::uint64_t dropped;
+};
+
+#endif /* FRAMESCHEDULER_H */
@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "batch.h"
+#include "chip8.h"
+#include "movie.h"
+#include "profiler.h"
+
+namespace {
+
+void usage(const char* name)
+{
+  std::cerr <<
+    "usage: " << name << " [options] <rom>\n"
+    "\n"
+    "runs a rom without a window and reports where it ended up\n"
+    "\n"
+    "  --cycles N            stop after N instructions\n"
+    "  --frames N            stop after N frames\n"
+    "  --halt EVENTS         stop at the first of a comma separated list of\n"
+    "                        draw, sound and keywait. an illegal opcode\n"
+    "                        always stops the run\n"
+    "  --input FILE          press keys as given by FILE, one \"<frame>\n"
+    "                        [key...]\" line per change with the keys as hex\n"
+    "                        digits and no keys releasing all of them\n"
+    "  --movie FILE          replay a movie recorded in the emulator, which\n"
+    "                        sets the seed, the clock rate, the input and\n"
+    "                        the length of the run\n"
+    "  --engine NAME         interpreter (default) or jit\n"
+    "  --seed N              seed of the random numbers (default 0)\n"
+    "  --cycles-per-frame N  instructions per 60 Hz frame (default 10)\n"
+    "  --stats               also report how often each opcode handler ran\n"
+    "                        and the time spent in DRW, needs a build with\n"
+    "                        -Dopcode_stats=ON\n"
+    "  --profile FILE        write an exact profile of the run to FILE as\n"
+    "                        collapsed stacks for flamegraph tools, with\n"
+    "                        subroutines by address and pcs as leaves\n"
+    "  --json                print the report as json\n";
+}
+
+bool parseNumber(const char* text, unsigned long& value)
+{
+  char* end = nullptr;
+  value = std::strtoul(text, &end, 0);
+  return *text != '\0' && *end == '\0';
+}
+
+bool parseEvents(const std::string& text, std::uint8_t& events)
+{
+  std::istringstream list(text);
+  std::string name;
+  while (std::getline(list, name, ',')) {
+    if      (name == "draw")    events |= chip8::EVENT_DRAW;
+    else if (name == "sound")   events |= chip8::EVENT_SOUND;
+    else if (name == "keywait") events |= chip8::EVENT_KEYWAIT;
+    else return false;
+  }
+  return true;
+}
+
+// the input script, frames are turned into cycles at the frame's start
+bool readInput(const std::string& filename, unsigned int cyclesPerFrame,
+  std::vector<InputEvent>& input)
+{
+  std::ifstream file(filename);
+  if (!file.is_open())
+    return false;
+
+  std::string line;
+  while (std::getline(file, line)) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream fields(line);
+
+    unsigned long frame;
+    if (!(fields >> frame))
+      continue;
+
+    std::uint16_t keys = 0;
+    std::string key;
+    while (fields >> key) {
+      unsigned long index;
+      if (key.size() != 1 || !parseNumber(("0x" + key).c_str(), index))
+        return false;
+      keys |= 1 << index;
+    }
+
+    std::uint64_t cycle = static_cast<std::uint64_t>(frame) * cyclesPerFrame;
+    if (!input.empty() && input.back().cycle > cycle)
+      return false;
+    input.push_back(InputEvent{cycle, keys});
+  }
+
+  return true;
+}
+
+// handlers that ran, most frequent first
+void printStats(const chip8::Stats& stats, unsigned long cycles)
+{
+  std::vector<unsigned int> order;
+  for (unsigned int i = 0; i < chip8::HANDLERS; i++)
+    if (stats.executed[i] > 0)
+      order.push_back(i);
+  std::stable_sort(order.begin(), order.end(),
+    [&](unsigned int a, unsigned int b) {
+      return stats.executed[a] > stats.executed[b];
+    });
+
+  std::cout << "\nhandler     executed   share\n";
+  for (unsigned int i : order) {
+    double share = cycles > 0 ? 100.0 * stats.executed[i] / cycles : 0;
+    std::cout << std::left << std::setw(8) << chip8::handlerNames[i]
+      << std::right << std::setw(12) << stats.executed[i]
+      << std::fixed << std::setprecision(2) << std::setw(7) << share << "%\n"
+      << std::defaultfloat;
+  }
+  std::cout << "\ntime in DRW " << stats.drawNanoseconds << " ns" << std::endl;
+}
+
+// the ten most executed addresses
+void printHotspots(const Profiler& profiler)
+{
+  auto spots = profiler.hotspots();
+  if (spots.size() > 10)
+    spots.resize(10);
+
+  std::cout << "\naddress     executed   share\n";
+  for (const auto& spot : spots) {
+    double share = 100.0 * spot.second / profiler.instructions();
+    std::cout << "0x" << std::hex << std::setw(3) << std::setfill('0')
+      << spot.first << std::dec << std::setfill(' ') << std::setw(15)
+      << spot.second << std::fixed << std::setprecision(2) << std::setw(7)
+      << share << "%\n" << std::defaultfloat;
+  }
+}
+
+std::string jsonString(const std::string& text)
+{
+  std::ostringstream out;
+  out << '"';
+  for (char c : text) {
+    if (c == '"' || c == '\\')
+      out << '\\' << c;
+    else if (static_cast<unsigned char>(c) < 0x20)
+      out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+          << static_cast<int>(c) << std::dec;
+    else
+      out << c;
+  }
+  out << '"';
+  return out.str();
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  // parse arguments
+  BatchJob job = BatchJob();
+  job.engine = chip8::Engine::Interpreter;
+  std::string romFile;
+  std::string inputFile;
+  std::string movieFile;
+  std::string profileFile;
+  bool json = false;
+  bool stats = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    unsigned long number = 0;
+    bool valid = true;
+
+    if (arg == "--json") {
+      json = true;
+      continue;
+    } else if (arg == "--stats") {
+      stats = true;
+      continue;
+    } else if (arg[0] != '-' && romFile.empty()) {
+      romFile = arg;
+      continue;
+    } else if (!value) {
+      valid = false;
+    } else if (arg == "--cycles") {
+      valid = parseNumber(value, job.cycles);
+    } else if (arg == "--frames") {
+      valid = parseNumber(value, job.frames);
+    } else if (arg == "--halt") {
+      valid = parseEvents(value, job.stopOn);
+    } else if (arg == "--input") {
+      inputFile = value;
+    } else if (arg == "--movie") {
+      movieFile = value;
+    } else if (arg == "--profile") {
+      profileFile = value;
+    } else if (arg == "--engine") {
+      valid = std::strcmp(value, "interpreter") == 0 ||
+              std::strcmp(value, "jit") == 0;
+      if (std::strcmp(value, "jit") == 0)
+        job.engine = chip8::Engine::Jit;
+    } else if (arg == "--seed") {
+      valid = parseNumber(value, number);
+      job.seed = number;
+    } else if (arg == "--cycles-per-frame") {
+      valid = parseNumber(value, number) && number > 0 && number <= UINT_MAX;
+      job.cyclesPerFrame = number;
+    } else {
+      valid = false;
+    }
+
+    if (!valid) {
+      usage(argv[0]);
+      return 2;
+    }
+    ++i;
+  }
+
+  if (romFile.empty() || (!inputFile.empty() && !movieFile.empty())) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  if (stats && !chip8::statsEnabled) {
+    std::cerr << "--stats needs a build with -Dopcode_stats=ON" << std::endl;
+    return 2;
+  }
+
+  // load the rom
+  std::ifstream file(romFile, std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "could not open " << romFile << std::endl;
+    return 1;
+  }
+  auto rom = std::make_shared<std::vector<std::uint8_t>>(
+    (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  job.rom = rom;
+
+  if (job.cyclesPerFrame == 0)
+    job.cyclesPerFrame = chip8().getCyclesPerFrame();
+
+  if (!movieFile.empty()) {
+    Movie movie;
+    if (!movie.load(movieFile)) {
+      std::cerr << "could not read movie " << movieFile << std::endl;
+      return 1;
+    }
+    if (!movie.matches(rom->data(), rom->size())) {
+      std::cerr << movieFile << " was recorded with another rom" << std::endl;
+      return 1;
+    }
+
+    job.seed = movie.seed;
+    job.cyclesPerFrame = movie.cyclesPerFrame;
+    job.input = movie.input;
+    if (job.cycles == 0 || job.cycles > movie.length)
+      job.cycles = movie.length;
+  }
+
+  if (!inputFile.empty() &&
+      !readInput(inputFile, job.cyclesPerFrame, job.input))
+  {
+    std::cerr << "could not read input script " << inputFile << std::endl;
+    return 1;
+  }
+
+  if (job.cycles == 0 && job.frames == 0 && job.stopOn == 0) {
+    std::cerr << "nothing ends the run, give --cycles, --frames, --halt or "
+      "--movie" << std::endl;
+    return 2;
+  }
+
+  if (!chip8::engineSupported(job.engine)) {
+    std::cerr << "the jit is not supported on this host" << std::endl;
+    return 1;
+  }
+
+  Profiler profiler;
+  if (!profileFile.empty())
+    job.profiler = &profiler;
+
+  // run
+  auto start = std::chrono::steady_clock::now();
+  BatchResult result = BatchRunner::runJob(job);
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+
+  if (!result.loaded) {
+    std::cerr << romFile << " does not fit into memory" << std::endl;
+    return 1;
+  }
+
+  if (job.profiler) {
+    std::ofstream profile(profileFile);
+    profiler.write(profile);
+    if (!profile.good()) {
+      std::cerr << "could not write profile " << profileFile << std::endl;
+      return 1;
+    }
+  }
+
+  // report
+  std::uint8_t halted = result.events & job.stopOn;
+  std::string stopped = "budget";
+  if      (result.illegalOpcode)                stopped = "illegal";
+  else if (halted & chip8::EVENT_DRAW)          stopped = "draw";
+  else if (halted & chip8::EVENT_SOUND)         stopped = "sound";
+  else if (halted & chip8::EVENT_KEYWAIT)       stopped = "keywait";
+
+  std::ostringstream hash;
+  hash << std::hex << std::setw(16) << std::setfill('0') << result.stateHash;
+
+  double seconds = elapsed.count();
+  unsigned long long ips = seconds > 0 ? result.cycles / seconds : 0;
+  std::string engine =
+    job.engine == chip8::Engine::Jit ? "jit" : "interpreter";
+
+  if (json) {
+    std::cout <<
+      "{\"rom\": " << jsonString(romFile) <<
+      ", \"engine\": \"" << engine << "\""
+      ", \"cycles\": " << result.cycles <<
+      ", \"frames\": " << result.frames <<
+      ", \"draws\": " << result.draws <<
+      ", \"stopped\": \"" << stopped << "\""
+      ", \"stateHash\": \"" << hash.str() << "\""
+      ", \"seconds\": " << seconds <<
+      ", \"ips\": " << ips;
+
+    if (stats) {
+      std::cout << ", \"stats\": {";
+      for (unsigned int i = 0; i < chip8::HANDLERS; i++)
+        std::cout << "\"" << chip8::handlerNames[i] << "\": " <<
+          result.stats.executed[i] << ", ";
+      std::cout << "\"drawNanoseconds\": " << result.stats.drawNanoseconds <<
+        "}";
+    }
+    std::cout << "}" << std::endl;
+  } else {
+    std::cout <<
+      "rom         " << romFile << "\n"
+      "engine      " << engine << "\n"
+      "cycles      " << result.cycles << "\n"
+      "frames      " << result.frames << "\n"
+      "draws       " << result.draws << "\n"
+      "stopped     " << stopped << "\n"
+      "state hash  " << hash.str() << "\n"
+      "seconds     " << seconds << "\n"
+      "ips         " << ips << std::endl;
+
+    if (stats)
+      printStats(result.stats, result.cycles);
+    if (job.profiler)
+      printHotspots(profiler);
+  }
+
+  return 0;
+}
@@ -0,0 +1,658 @@
+#include "jit.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "chip8.h"
+
+#if defined(__x86_64__)
+#include <sys/mman.h>
+#define JIT_SUPPORTED 1
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+namespace {
+
+// longest run of instructions translated into a single block
+const unsigned int maxBlockLength = 256;
+
+// size of the executable memory region, and of the pages it is made of
+const std::size_t regionSize = 4 * 1024 * 1024;
+const std::size_t pageSize = 4096;
+
+// x86 registers used by the generated code
+const std::uint8_t EAX = 0;
+const std::uint8_t ECX = 1;
+const std::uint8_t EDX = 2;
+
+template<typename T>
+std::int32_t offsetOf(const chip8& emu, const T& member)
+{
+  return reinterpret_cast<const char*>(&member) -
+    reinterpret_cast<const char*>(&emu);
+}
+
+}
+
+Jit::Jit(chip8& emu) :
+  emu(emu),
+  offV(offsetOf(emu, emu.V)),
+  offI(offsetOf(emu, emu.I)),
+  offPc(offsetOf(emu, emu.pc)),
+  offMemory(offsetOf(emu, emu.memory)),
+  offDelay(offsetOf(emu, emu.delay_timer)),
+  offSp(offsetOf(emu, emu.sp)),
+  offStack(offsetOf(emu, emu.stack)),
+  offKey(offsetOf(emu, emu.key)),
+  offEvents(offsetOf(emu, emu.events)),
+  offRng(offsetOf(emu, emu.rng)),
+  entries(),
+  coverage(),
+  code(nullptr),
+  enter(nullptr),
+  leave(0),
+  step(0),
+  codeSize(0),
+  codeUsed(0),
+  compiled(0),
+  stopOn(0),
+  dropped(false)
+{
+#if JIT_SUPPORTED
+  void* region = mmap(nullptr, regionSize, PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (region != MAP_FAILED) {
+    code = static_cast<std::uint8_t*>(region);
+    codeSize = regionSize;
+    flush();
+  }
+#endif
+}
+
+Jit::~Jit()
+{
+#if JIT_SUPPORTED
+  if (code)
+    munmap(code, codeSize);
+#endif
+}
+
+bool Jit::supported()
+{
+  return JIT_SUPPORTED;
+}
+
+unsigned long Jit::run(unsigned long cycles, std::uint8_t stopOn)
+{
+  this->stopOn = stopOn;
+
+  unsigned long done = 0;
+  while (done < cycles) {
+    std::uint16_t pc = emu.pc;
+
+    // a block is entered at any of its instructions, so one cut short
+    // goes on where it stopped
+    const std::uint8_t* entry = nullptr;
+    if (code && pc + 1 < static_cast<int>(blocks.size())) {
+      entry = entries[pc];
+      if (!entry) {
+        Block* block = blocks[pc] ? blocks[pc].get() : compile(pc);
+        if (block->length > 0)
+          entry = code + block->offset;
+      }
+    }
+
+    // the blocks stop at a branch into code not compiled yet, at the end
+    // of the budget or the current frame, or after an instruction of the
+    // interpreter that raised an event to stop on, is still waiting or
+    // dropped compiled code
+    if (entry) {
+      unsigned long budget = std::min<unsigned long>(cycles - done,
+        emu.cyclesPerFrame - emu.frameCycle);
+      dropped = false;
+      unsigned int ran = budget - enter(&emu, budget, entry);
+      done += ran;
+      compiled += ran;
+#ifdef CHIP8_STATS
+      emu.countBlock(pc, ran);
+#endif
+
+      emu.frameCycle += ran;
+      if (emu.frameCycle == emu.cyclesPerFrame)
+        emu.endFrame();
+
+      if (done == cycles || (emu.events & stopOn))
+        break;
+      continue;
+    }
+
+    // the interpreter handles the last instruction of memory
+    emu.emulateCycle();
+    ++done;
+
+    if (emu.events & stopOn)
+      break;
+  }
+
+  return done;
+}
+
+void Jit::invalidate(unsigned int addr, unsigned int len)
+{
+  unsigned int last = std::min<unsigned int>(addr + len, coverage.size());
+
+  bool covered = false;
+  for (unsigned int i = addr; i < last && !covered; ++i)
+    covered = coverage[i] != 0;
+  if (!covered)
+    return;
+
+  for (auto& block : blocks) {
+    if (!block || block->start >= last || block->end + 2u <= addr)
+      continue;
+
+    const std::uint8_t* begin = code + block->offset;
+    unsigned int end = std::min<unsigned int>(block->end + 2, coverage.size());
+    for (unsigned int i = block->start; i < end; ++i) {
+      --coverage[i];
+      if (block->length > 0 && entries[i] >= begin &&
+          entries[i] < begin + block->size)
+        entries[i] = nullptr;
+    }
+    block.reset();
+    dropped = true;
+  }
+}
+
+void Jit::flush()
+{
+  for (auto& block : blocks)
+    block.reset();
+  entries.fill(nullptr);
+  coverage.fill(0);
+  codeUsed = 0;
+
+  // push rbx; push r12; sub rsp, 8 to keep calls aligned; mov rbx, rdi;
+  // mov r12d, esi; jmp rdx to the instruction to start at
+  buffer.clear();
+  emit(0x53);
+  emit(0x41); emit(0x54);
+  emit(0x48); emit(0x83); emit(0xEC); emit(0x08);
+  emit(0x48); emit(0x89); emit(0xFB);
+  emit(0x41); emit(0x89); emit(0xF4);
+  emit(0xFF); emit(0xE2);
+
+  // leave: return the budget left; add rsp, 8; pop r12; pop rbx; ret
+  leave = buffer.size();
+  emit(0x44); emit(0x89); emit(0xE0);              // mov eax, r12d
+  emit(0x48); emit(0x83); emit(0xC4); emit(0x08);
+  emit(0x41); emit(0x5C);
+  emit(0x5B);
+  emit(0xC3);
+
+  // step: runs the instruction at esi in the interpreter and returns to
+  // the block, or leaves if it stayed on it, raised an event to stop on
+  // or dropped compiled code. the code of a dropped block stays in place
+  // until the next flush
+  std::uint64_t fn = reinterpret_cast<std::uint64_t>(&Jit::interpret);
+  std::uint64_t stops = reinterpret_cast<std::uint64_t>(&stopOn);
+  std::uint64_t drops = reinterpret_cast<std::uint64_t>(&dropped);
+  std::vector<std::size_t> out;
+  step = buffer.size();
+  emit(0x56);                                      // push rsi
+  emit(0x48); emit(0x89); emit(0xDF);              // mov rdi, rbx
+  emit(0x48); emit(0xB8);                          // mov rax, fn
+  emit32(fn & 0xFFFFFFFF); emit32(fn >> 32);
+  emit(0xFF); emit(0xD0);                          // call rax
+  emit(0x59);                                      // pop rcx
+  emit(0x83); emit(0xC1); emit(0x02);              // add ecx, 2
+  emit(0x66); emitMem(0x39, ECX, offPc);           // cmp word [pc], cx
+  emit(0x75); emit(0);                             // jne out
+  out.push_back(buffer.size());
+  emit(0x48); emit(0xB8);                          // mov rax, stopOn
+  emit32(stops & 0xFFFFFFFF); emit32(stops >> 32);
+  emit(0x8A); emit(0x10);                          // mov dl, [rax]
+  emitMem(0x84, EDX, offEvents);                   // test [events], dl
+  emit(0x75); emit(0);                             // jnz out
+  out.push_back(buffer.size());
+  emit(0x48); emit(0xB8);                          // mov rax, dropped
+  emit32(drops & 0xFFFFFFFF); emit32(drops >> 32);
+  emit(0x80); emit(0x38); emit(0x00);              // cmp byte [rax], 0
+  emit(0x75); emit(0);                             // jne out
+  out.push_back(buffer.size());
+  emit(0xC3);                                      // ret
+
+  // out: drop the return address into the block, jmp leave
+  for (std::size_t next : out)
+    buffer[next - 1] = buffer.size() - next;
+  emit(0x48); emit(0x83); emit(0xC4); emit(0x08);  // add rsp, 8
+  emit(0xE9); emit32(leave - (buffer.size() + 4));
+
+  enter = reinterpret_cast<Trampoline>(code + place());
+}
+
+// copies the buffer to the end of the executable memory, returns where
+std::size_t Jit::place()
+{
+  std::size_t offset = codeUsed;
+
+#if JIT_SUPPORTED
+  // only the pages the code lands on change protection
+  std::size_t first = offset & ~(pageSize - 1);
+  std::size_t last = (offset + buffer.size() + pageSize - 1) &
+    ~(pageSize - 1);
+  mprotect(code + first, last - first, PROT_READ | PROT_WRITE);
+  std::memcpy(code + offset, buffer.data(), buffer.size());
+  mprotect(code + first, last - first, PROT_READ | PROT_EXEC);
+#endif
+
+  codeUsed += buffer.size();
+  return offset;
+}
+
+Jit::Block* Jit::compile(std::uint16_t addr)
+{
+  buffer.clear();
+
+  // every instruction is preceded by a check of the budget, which leaves
+  // through a stub out of line with eax = instructions of the block in
+  // front of it
+  std::vector<std::size_t> starts;
+  std::vector<std::size_t> checks;
+  std::vector<std::size_t> leaves;
+  std::vector<std::size_t> steps;
+  unsigned int length = 0;
+  std::uint16_t end = addr;
+  bool branches = false;
+  while (end + 1 < static_cast<int>(emu.memory.size()) &&
+         length < maxBlockLength)
+  {
+    std::size_t check = buffer.size();
+    emit(0x41); emit(0x83); emit(0xEC); emit(0x01);  // sub r12d, 1
+    emit(0x0F); emit(0x82); emit32(0);             // jb stub
+    checks.push_back(buffer.size());
+
+    std::uint16_t opcode = (emu.memory[end] << 8) | emu.memory[end + 1];
+    if (!emitInstruction(opcode)) {
+      branches = emitBranch(end, opcode);
+      if (!branches)
+        emitInterpreted(end, steps);
+    }
+
+    starts.push_back(check);
+    end += 2;
+    ++length;
+    if (branches)
+      break;
+  }
+
+  if (branches) {
+#ifndef CHIP8_STATS
+    // the branch has set pc, go on into the block there if there is one.
+    // the statistics count each block on its own, so they don't chain
+    std::uint64_t table = reinterpret_cast<std::uint64_t>(entries.data());
+    emit(0x0F); emitMem(0xB7, EAX, offPc);         // movzx eax, word [pc]
+    emit(0x3D); emit32(0xFFF);                     // cmp eax, 0xFFF
+    emit(0x0F); emit(0x83); emit32(0);             // jae leave
+    leaves.push_back(buffer.size());
+    emit(0x48); emit(0xBA);                        // mov rdx, table
+    emit32(table & 0xFFFFFFFF); emit32(table >> 32);
+    emit(0x48); emit(0x8B); emit(0x14); emit(0xC2);  // mov rdx, [rdx+rax*8]
+    emit(0x48); emit(0x85); emit(0xD2);            // test rdx, rdx
+    emit(0x0F); emit(0x84); emit32(0);             // jz leave
+    leaves.push_back(buffer.size());
+    emit(0xFF); emit(0xE2);                        // jmp rdx
+#else
+    emit(0xE9); emit32(0);                         // jmp leave
+    leaves.push_back(buffer.size());
+#endif
+  } else {
+    emit(0xB8); emit32(length);                    // mov eax, length
+  }
+
+  // exit: pc = addr + eax * 2, jmp leave
+  std::size_t exit = buffer.size();
+  emit(0x8D); emit(0x0C); emit(0x45); emit32(addr);  // lea ecx, [rax*2+addr]
+  emit(0x66); emitMem(0x89, ECX, offPc);           // mov word [pc], cx
+  emit(0xE9); emit32(0);                           // jmp leave
+  leaves.push_back(buffer.size());
+
+  // spent: the budget went below 0 in the check, none is left
+  std::size_t spent = buffer.size();
+  emit(0x45); emit(0x31); emit(0xE4);              // xor r12d, r12d
+  emit(0xEB); emit(exit - (buffer.size() + 1));    // jmp exit
+
+  // stubs: mov eax, instruction; jmp spent
+  for (std::size_t i = 0; i < checks.size(); ++i) {
+    std::uint32_t rel = buffer.size() - checks[i];
+    std::memcpy(&buffer[checks[i] - 4], &rel, sizeof(rel));
+    emit(0xB8); emit32(i);
+    emit(0xE9); emit32(spent - (buffer.size() + 4));
+  }
+
+  Block* block = new Block{addr, end, length, 0, 0};
+  if (length > 0) {
+    if (buffer.size() > codeSize - codeUsed)
+      flush();
+
+    for (std::size_t next : leaves) {
+      std::uint32_t rel = leave - (codeUsed + next);
+      std::memcpy(&buffer[next - 4], &rel, sizeof(rel));
+    }
+    for (std::size_t next : steps) {
+      std::uint32_t rel = step - (codeUsed + next);
+      std::memcpy(&buffer[next - 4], &rel, sizeof(rel));
+    }
+    block->offset = place();
+    block->size = buffer.size();
+    for (unsigned int i = 0; i < length; ++i)
+      entries[addr + 2 * i] = code + block->offset + starts[i];
+  }
+
+  // the block depends on its own instructions and the one that ended it
+  unsigned int last = std::min<unsigned int>(end + 2, coverage.size());
+  for (unsigned int i = addr; i < last; ++i)
+    ++coverage[i];
+
+  blocks[addr].reset(block);
+  return block;
+}
+
+void Jit::emit(std::uint8_t byte)
+{
+  buffer.push_back(byte);
+}
+
+void Jit::emit16(std::uint16_t value)
+{
+  emit(value & 0xFF);
+  emit(value >> 8);
+}
+
+void Jit::emit32(std::uint32_t value)
+{
+  emit16(value & 0xFFFF);
+  emit16(value >> 16);
+}
+
+// op reg, [rbx + disp32]
+void Jit::emitMem(std::uint8_t op, std::uint8_t reg, std::int32_t disp)
+{
+  emit(op);
+  emit(0x83 | (reg << 3));
+  emit32(disp);
+}
+
+// movzx reg, byte [rbx + disp32]
+void Jit::emitLoad(std::uint8_t reg, std::int32_t disp)
+{
+  emit(0x0F);
+  emitMem(0xB6, reg, disp);
+}
+
+// mov byte [rbx + disp32], reg
+void Jit::emitStore(std::uint8_t reg, std::int32_t disp)
+{
+  emitMem(0x88, reg, disp);
+}
+
+// returns false for branches and anything left to the interpreter
+bool Jit::emitInstruction(std::uint16_t opcode)
+{
+  std::uint8_t  x   = (opcode & 0x0F00) >> 8;
+  std::uint8_t  y   = (opcode & 0x00F0) >> 4;
+  std::uint8_t  nn  = (opcode & 0x00FF);
+  std::uint16_t nnn = (opcode & 0x0FFF);
+
+  std::int32_t vx = offV + x;
+  std::int32_t vy = offV + y;
+  std::int32_t vf = offV + 0xF;
+
+  switch (opcode & 0xF000) {
+  case 0x6000:
+    emitMem(0xC6, 0, vx); emit(nn);           // mov byte [vx], nn
+    return true;
+  case 0x7000:
+    emitMem(0x80, 0, vx); emit(nn);           // add byte [vx], nn
+    return true;
+  case 0x8000:
+    switch (opcode & 0x000F) {
+    case 0x0:
+      emitLoad(EAX, vy);
+      emitStore(EAX, vx);
+      return true;
+    case 0x1:
+      emitLoad(EAX, vy);
+      emitMem(0x08, EAX, vx);                 // or [vx], al
+      return true;
+    case 0x2:
+      emitLoad(EAX, vy);
+      emitMem(0x20, EAX, vx);                 // and [vx], al
+      return true;
+    case 0x3:
+      emitLoad(EAX, vy);
+      emitMem(0x30, EAX, vx);                 // xor [vx], al
+      return true;
+    case 0x4:
+      // vf = carry of vx + vy, then vx += vy with the updated registers
+      emitLoad(EAX, vx);
+      emitLoad(ECX, vy);
+      emit(0x00); emit(0xC8);                 // add al, cl
+      emit(0x0F); emit(0x92); emit(0xC2);     // setc dl
+      emitStore(EDX, vf);
+      emitLoad(EAX, vx);
+      emitLoad(ECX, vy);
+      emit(0x00); emit(0xC8);                 // add al, cl
+      emitStore(EAX, vx);
+      return true;
+    case 0x5:
+    case 0x7: {
+      // 0x5: vf = vx > vy, vx = vx - vy
+      // 0x7: vf = vy > vx, vx = vy - vx
+      std::int32_t a = (opcode & 0x000F) == 0x5 ? vx : vy;
+      std::int32_t b = (opcode & 0x000F) == 0x5 ? vy : vx;
+      emitLoad(EAX, a);
+      emitLoad(ECX, b);
+      emit(0x38); emit(0xC8);                 // cmp al, cl
+      emit(0x0F); emit(0x97); emit(0xC2);     // seta dl
+      emitStore(EDX, vf);
+      emitLoad(EAX, a);
+      emitLoad(ECX, b);
+      emit(0x28); emit(0xC8);                 // sub al, cl
+      emitStore(EAX, vx);
+      return true;
+    }
+    case 0x6:
+      emitLoad(EAX, vx);
+      emit(0x24); emit(0x01);                 // and al, 1
+      emitStore(EAX, vf);
+      emitLoad(EAX, vx);
+      emit(0xD0); emit(0xE8);                 // shr al, 1
+      emitStore(EAX, vx);
+      return true;
+    case 0xE:
+      emitLoad(EAX, vx);
+      emit(0xC0); emit(0xE8); emit(0x07);     // shr al, 7
+      emitStore(EAX, vf);
+      emitLoad(EAX, vx);
+      emit(0xD0); emit(0xE0);                 // shl al, 1
+      emitStore(EAX, vx);
+      return true;
+    }
+    return false;
+  case 0xA000:
+    emit(0x66); emitMem(0xC7, 0, offI);       // mov word [I], nnn
+    emit16(nnn);
+    return true;
+  case 0xC000: {
+    // xorshift64* as in chip8::random, vx = top byte of the output & nn
+    const std::uint8_t shifts[3][2] = {{0xEA, 12}, {0xE2, 25}, {0xEA, 27}};
+    emit(0x48); emitMem(0x8B, EAX, offRng);   // mov rax, [rng]
+    for (auto& shift : shifts) {
+      emit(0x48); emit(0x89); emit(0xC2);     // mov rdx, rax
+      emit(0x48); emit(0xC1); emit(shift[0]); // shr/shl rdx, n
+      emit(shift[1]);
+      emit(0x48); emit(0x31); emit(0xD0);     // xor rax, rdx
+    }
+    emit(0x48); emitMem(0x89, EAX, offRng);   // mov [rng], rax
+    emit(0x48); emit(0xBA);                   // mov rdx, multiplier
+    emit32(0x4F6CDD1D); emit32(0x2545F491);
+    emit(0x48); emit(0x0F); emit(0xAF); emit(0xC2);  // imul rax, rdx
+    emit(0x48); emit(0xC1); emit(0xE8); emit(56);    // shr rax, 56
+    emit(0x24); emit(nn);                     // and al, nn
+    emitStore(EAX, vx);
+    return true;
+  }
+  case 0xF000:
+    switch (nn) {
+    case 0x07:
+      emitLoad(EAX, offDelay);
+      emitStore(EAX, vx);
+      return true;
+    case 0x15:
+      emitLoad(EAX, vx);
+      emitStore(EAX, offDelay);
+      return true;
+    case 0x1E:
+      // vf = I + vx > 0xFFF, then I += vx with the updated registers
+      emit(0x0F); emitMem(0xB7, EAX, offI);   // movzx eax, word [I]
+      emitLoad(ECX, vx);
+      emit(0x01); emit(0xC8);                 // add eax, ecx
+      emit(0x3D); emit32(0xFFF);              // cmp eax, 0xFFF
+      emit(0x0F); emit(0x97); emit(0xC2);     // seta dl
+      emitStore(EDX, vf);
+      emitLoad(ECX, vx);
+      emit(0x66); emitMem(0x01, ECX, offI);   // add word [I], cx
+      return true;
+    case 0x29:
+      emitLoad(EAX, vx);
+      emit(0x8D); emit(0x04); emit(0x80);     // lea eax, [rax + rax * 4]
+      emit(0x66); emitMem(0x89, EAX, offI);   // mov word [I], ax
+      return true;
+    case 0x65:
+      emit(0x0F); emitMem(0xB7, EAX, offI);   // movzx eax, word [I]
+      for (std::uint8_t i = 0; i <= x; ++i) {
+        // the address wraps around the end of memory
+        emit(0x8D); emit(0x50); emit(i);         // lea edx, [rax + i]
+        emit(0x81); emit(0xE2); emit32(0xFFF);   // and edx, 0xFFF
+        // mov cl, [rbx + rdx + memory]
+        emit(0x8A); emit(0x8C); emit(0x13); emit32(offMemory);
+        emitStore(ECX, offV + i);
+      }
+      return true;
+    }
+    return false;
+  }
+
+  return false;
+}
+
+// jumps, calls, returns and skips, which end the block with pc set to
+// where they go. returns false for anything else
+bool Jit::emitBranch(std::uint16_t addr, std::uint16_t opcode)
+{
+  std::uint8_t  x   = (opcode & 0x0F00) >> 8;
+  std::uint8_t  y   = (opcode & 0x00F0) >> 4;
+  std::uint8_t  nn  = (opcode & 0x00FF);
+  std::uint16_t nnn = (opcode & 0x0FFF);
+
+  std::int32_t vx = offV + x;
+  std::int32_t vy = offV + y;
+
+  // skips compare, then pick addr + 2 or addr + 4 with cmovcc ecx, edx
+  std::uint8_t skipIf = 0;
+  auto beginSkip = [&]() {
+    emit(0xB9); emit32(addr + 2);             // mov ecx, addr + 2
+    emit(0xBA); emit32(addr + 4);             // mov edx, addr + 4
+  };
+  const std::uint8_t CMOVE  = 0x44;
+  const std::uint8_t CMOVNE = 0x45;
+
+  switch (opcode & 0xF000) {
+  case 0x0000:
+    if (opcode != 0x00EE)
+      return false;
+    // --sp, pc = stack[sp & 0xF] + 2
+    emit(0x0F); emitMem(0xB7, EAX, offSp);    // movzx eax, word [sp]
+    emit(0xFF); emit(0xC8);                   // dec eax
+    emit(0x66); emitMem(0x89, EAX, offSp);    // mov word [sp], ax
+    emit(0x83); emit(0xE0); emit(0x0F);       // and eax, 0xF
+    // movzx ecx, word [rbx + rax * 2 + stack]
+    emit(0x0F); emit(0xB7); emit(0x8C); emit(0x43); emit32(offStack);
+    emit(0x83); emit(0xC1); emit(0x02);       // add ecx, 2
+    emit(0x66); emitMem(0x89, ECX, offPc);    // mov word [pc], cx
+    return true;
+  case 0x1000:
+    emit(0x66); emitMem(0xC7, 0, offPc);      // mov word [pc], nnn
+    emit16(nnn);
+    return true;
+  case 0x2000:
+    // stack[sp & 0xF] = addr, ++sp, pc = nnn
+    emit(0x0F); emitMem(0xB7, EAX, offSp);    // movzx eax, word [sp]
+    emit(0x89); emit(0xC1);                   // mov ecx, eax
+    emit(0x83); emit(0xE1); emit(0x0F);       // and ecx, 0xF
+    // mov word [rbx + rcx * 2 + stack], addr
+    emit(0x66); emit(0xC7); emit(0x84); emit(0x4B); emit32(offStack);
+    emit16(addr);
+    emit(0xFF); emit(0xC0);                   // inc eax
+    emit(0x66); emitMem(0x89, EAX, offSp);    // mov word [sp], ax
+    emit(0x66); emitMem(0xC7, 0, offPc);      // mov word [pc], nnn
+    emit16(nnn);
+    return true;
+  case 0x3000:
+  case 0x4000:
+    beginSkip();
+    emitMem(0x80, 7, vx); emit(nn);           // cmp byte [vx], nn
+    skipIf = (opcode & 0xF000) == 0x3000 ? CMOVE : CMOVNE;
+    break;
+  case 0x5000:
+  case 0x9000:
+    if ((opcode & 0x000F) != 0)
+      return false;
+    beginSkip();
+    emitLoad(EAX, vx);
+    emitMem(0x3A, EAX, vy);                   // cmp al, [vy]
+    skipIf = (opcode & 0xF000) == 0x5000 ? CMOVE : CMOVNE;
+    break;
+  case 0xB000:
+    emitLoad(EAX, offV);                      // movzx eax, byte [v0]
+    emit(0x05); emit32(nnn);                  // add eax, nnn
+    emit(0x66); emitMem(0x89, EAX, offPc);    // mov word [pc], ax
+    return true;
+  case 0xE000:
+    if (nn != 0x9E && nn != 0xA1)
+      return false;
+    beginSkip();
+    emitLoad(EAX, vx);
+    emit(0x83); emit(0xE0); emit(0x0F);       // and eax, 0xF
+    // cmp byte [rbx + rax + key], 0
+    emit(0x80); emit(0xBC); emit(0x03); emit32(offKey); emit(0x00);
+    skipIf = nn == 0x9E ? CMOVNE : CMOVE;
+    break;
+  default:
+    return false;
+  }
+
+  emit(0x0F); emit(skipIf); emit(0xCA);       // cmovcc ecx, edx
+  emit(0x66); emitMem(0x89, ECX, offPc);      // mov word [pc], cx
+  return true;
+}
+
+// calls the interpreter for the instruction at addr
+void Jit::emitInterpreted(std::uint16_t addr,
+  std::vector<std::size_t>& steps)
+{
+  emit(0xBE); emit32(addr);                   // mov esi, addr
+  emit(0xE8); emit32(0);                      // call step
+  steps.push_back(buffer.size());
+}
+
+void Jit::interpret(chip8* emu, std::uint16_t addr)
+{
+  emu->pc = addr;
+  const Instruction& in = emu->decoded[addr];
+  if (in.fn == nullptr)
+    emu->decode(addr);
+  (emu->*in.fn)(in);
+}
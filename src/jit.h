@@ -0,0 +1,111 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class chip8;
+
+// translates straight-line runs of chip8 instructions into x86-64 code.
+// a block ends with a jump, call, return or skip, which it runs itself and
+// goes on straight into the block at its target. memory writes and
+// anything raising an event (CLS, DRW, LD_STV, LD_VK) are run by the
+// interpreter from inside the block
+class Jit
+{
+public:
+  Jit(chip8& emu);
+  ~Jit();
+
+  // whether native code can be generated on this host
+  static bool supported();
+
+  // run at most cycles instructions, stopping after an event in stopOn.
+  // returns the amount executed
+  unsigned long run(unsigned long cycles, std::uint8_t stopOn);
+
+  // drop every block reading from [addr, addr + len)
+  void invalidate(unsigned int addr, unsigned int len);
+
+  // instructions run as native code so far
+  std::uint64_t compiledCycles() const { return compiled; }
+
+private:
+  // enters the generated code at entry with the budget of instructions it
+  // may run, at least 1. blocks pass the budget on to the block their
+  // branch lands in, the rest of it is returned with pc on the next
+  // instruction
+  typedef unsigned int (*Trampoline)(chip8*, unsigned int budget,
+    const std::uint8_t* entry);
+
+  struct Block
+  {
+    std::uint16_t start;
+    std::uint16_t end;
+    unsigned int length;
+
+    // where its code is in the executable memory
+    std::size_t offset;
+    std::size_t size;
+  };
+
+  Block* compile(std::uint16_t addr);
+  void flush();
+  std::size_t place();
+
+  // emitters
+  void emit(std::uint8_t);
+  void emit16(std::uint16_t);
+  void emit32(std::uint32_t);
+  void emitMem(std::uint8_t op, std::uint8_t reg, std::int32_t disp);
+  void emitLoad(std::uint8_t reg, std::int32_t disp);
+  void emitStore(std::uint8_t reg, std::int32_t disp);
+  bool emitInstruction(std::uint16_t opcode);
+  bool emitBranch(std::uint16_t addr, std::uint16_t opcode);
+  void emitInterpreted(std::uint16_t addr, std::vector<std::size_t>& steps);
+
+  static void interpret(chip8* emu, std::uint16_t addr);
+
+  chip8& emu;
+
+  // offsets of the machine state relative to the chip8 object
+  std::int32_t offV;
+  std::int32_t offI;
+  std::int32_t offPc;
+  std::int32_t offMemory;
+  std::int32_t offDelay;
+  std::int32_t offSp;
+  std::int32_t offStack;
+  std::int32_t offKey;
+  std::int32_t offEvents;
+  std::int32_t offRng;
+
+  // blocks by start address, where each instruction is entered in the
+  // newest block it is part of, and how many blocks read each byte
+  std::array<std::unique_ptr<Block>, 4096> blocks;
+  std::array<const std::uint8_t*, 4096> entries;
+  std::array<std::uint16_t, 4096> coverage;
+
+  // executable memory, filled front to back and flushed when full. the
+  // trampoline sits in front, followed by the code every block leaves by
+  // and the one running an instruction in the interpreter
+  std::uint8_t* code;
+  Trampoline enter;
+  std::size_t leave;
+  std::size_t step;
+  std::size_t codeSize;
+  std::size_t codeUsed;
+  std::vector<std::uint8_t> buffer;
+
+  std::uint64_t compiled;
+
+  // the events the current run stops on, and whether a block was dropped
+  // since the generated code was entered, both read by the blocks
+  std::uint8_t stopOn;
+  bool dropped;
+};
+
+#endif /* JIT_H */
@@ -0,0 +1,81 @@
+#include "keymapdialog.h"
+
+#include <QDialogButtonBox>
+#include <QKeyEvent>
+#include <QKeySequence>
+#include <QPushButton>
+#include <QString>
+#include <QVBoxLayout>
+
+KeyMapDialog::KeyMapDialog(EmulatorCanvas* emulator, QWidget* parent) :
+  QDialog(parent),
+  emulator(emulator),
+  keys(emulator->keyMap()),
+  table(new QTableWidget(16, 1, this))
+{
+  setWindowTitle(tr("Keys"));
+
+  table->setHorizontalHeaderLabels(QStringList() << tr("Key"));
+  table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  table->setSelectionMode(QAbstractItemView::SingleSelection);
+  for (int i = 0; i < 16; i++) {
+    table->setVerticalHeaderItem(i,
+      new QTableWidgetItem(QString::number(i, 16).toUpper()));
+    table->setItem(i, 0, new QTableWidgetItem());
+  }
+  table->installEventFilter(this);
+  fill();
+
+  QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok |
+    QDialogButtonBox::Cancel | QDialogButtonBox::RestoreDefaults, this);
+
+  QVBoxLayout* layout = new QVBoxLayout(this);
+  layout->addWidget(table);
+  layout->addWidget(buttons);
+
+  connect(buttons, SIGNAL(accepted()), SLOT(apply()));
+  connect(buttons, SIGNAL(rejected()), SLOT(reject()));
+  connect(buttons->button(QDialogButtonBox::RestoreDefaults),
+    SIGNAL(clicked()), SLOT(restoreDefaults()));
+}
+
+void KeyMapDialog::apply()
+{
+  emulator->setKeyMap(keys);
+  accept();
+}
+
+void KeyMapDialog::restoreDefaults()
+{
+  keys = EmulatorCanvas::defaultKeyMap();
+  fill();
+}
+
+// a key pressed on a row binds it and moves on to the next row. escape
+// still closes the dialog, and tab and backspace are taken by fast
+// forward and rewind
+bool KeyMapDialog::eventFilter(QObject* object, QEvent* event)
+{
+  if (object != table || event->type() != QEvent::KeyPress)
+    return QDialog::eventFilter(object, event);
+
+  int key = static_cast<QKeyEvent*>(event)->key();
+  int row = table->currentRow();
+  if (row < 0 || key == Qt::Key_Escape || key == Qt::Key_Tab ||
+      key == Qt::Key_Backtab || key == Qt::Key_Backspace ||
+      key == Qt::Key_Shift || key == Qt::Key_Control ||
+      key == Qt::Key_Alt || key == Qt::Key_Meta)
+    return QDialog::eventFilter(object, event);
+
+  keys[row] = key;
+  fill();
+  table->setCurrentCell((row + 1) % 16, 0);
+  return true;
+}
+
+void KeyMapDialog::fill()
+{
+  for (int i = 0; i < 16; i++)
+    table->item(i, 0)->setText(
+      QKeySequence(keys[i]).toString(QKeySequence::NativeText));
+}
@@ -0,0 +1,31 @@
+#ifndef KEYMAPDIALOG_H
+#define KEYMAPDIALOG_H
+
+#include <QDialog>
+#include <QEvent>
+#include <QTableWidget>
+
+#include "emulatorcanvas.h"
+
+// lets the user bind each chip8 key to a key of the keyboard: select a
+// row and press the key it should be
+class KeyMapDialog : public QDialog
+{
+  Q_OBJECT
+public:
+  KeyMapDialog(EmulatorCanvas*, QWidget* parent = nullptr);
+
+private slots:
+  void apply();
+  void restoreDefaults();
+
+private:
+  bool eventFilter(QObject*, QEvent*) override;
+  void fill();
+
+  EmulatorCanvas* emulator;
+  EmulatorCanvas::KeyMap keys;
+  QTableWidget* table;
+};
+
+#endif /* KEYMAPDIALOG_H */
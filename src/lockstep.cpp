@@ -0,0 +1,444 @@
+#include "lockstep.h"
+#include "fnv.h"
+
+#include <algorithm>
+
+// addresses, stack slots and keys wrap into range for every lane, the
+// same as in chip8
+
+namespace {
+
+// value in the active lanes and keep in the others, without a branch so
+// the loops over the lanes vectorize
+template<typename T>
+T pick(std::uint8_t active, T value, T keep)
+{
+  T mask = static_cast<T>(-active);
+  return static_cast<T>((value & mask) | (keep & ~mask));
+}
+
+}
+
+template<unsigned int N>
+Lockstep<N>::Lockstep() :
+  cyclesPerFrame(10)
+{
+  rngSeed.fill(0);
+  reset();
+}
+
+template<unsigned int N>
+void Lockstep<N>::reset()
+{
+  I.fill(0);
+  pc.fill(0x200);
+  sp.fill(0);
+  delay_timer.fill(0);
+  sound_timer.fill(0);
+  frameCycle.fill(0);
+  beeps.fill(0);
+  illegal.fill(0);
+  done.fill(0);
+
+  for (unsigned int l = 0; l < N; l++)
+    rng[l] = chip8::rngState(rngSeed[l]);
+
+  for (auto& lanes : stack)  lanes.fill(0);
+  for (auto& lanes : memory) lanes.fill(0);
+  for (auto& lanes : V)      lanes.fill(0);
+  for (auto& lanes : gfx)    lanes.fill(0);
+  for (auto& lanes : key)    lanes.fill(0);
+
+  for (unsigned int i = 0; i < chip8::chip8_fontset.size(); i++)
+    memory[i].fill(chip8::chip8_fontset[i]);
+}
+
+template<unsigned int N>
+bool Lockstep<N>::loadGame(const std::uint8_t* data, std::size_t size)
+{
+  if (size > memory.size() - 512)
+    return false;
+
+  reset();
+  for (std::size_t i = 0; i < size; i++)
+    memory[512 + i].fill(data[i]);
+
+  return true;
+}
+
+template<unsigned int N>
+void Lockstep<N>::runCycles(unsigned long cycles)
+{
+  done.fill(0);
+
+  for (;;) {
+    // the lane furthest behind picks the instruction
+    unsigned int leader = 0;
+    for (unsigned int l = 1; l < N; l++)
+      if (done[l] < done[leader])
+        leader = l;
+    if (done[leader] >= cycles)
+      break;
+
+    std::uint16_t at = pc[leader];
+    const Mask& hi = memory[at & 0xFFF];
+    const Mask& lo = memory[(at + 1) & 0xFFF];
+    std::uint16_t opcode = (hi[leader] << 8) | lo[leader];
+
+    // every lane on the same instruction runs it as well
+    Mask active;
+    for (unsigned int l = 0; l < N; l++)
+      active[l] = (pc[l] == at) & (hi[l] == hi[leader]) &
+        (lo[l] == lo[leader]) & (done[l] < cycles);
+
+    execute(opcode, active);
+
+    // count the cycle and end the frame of each lane that ran it
+    for (unsigned int l = 0; l < N; l++) {
+      done[l] += active[l];
+      frameCycle[l] += active[l];
+
+      std::uint8_t end = frameCycle[l] == cyclesPerFrame;
+      frameCycle[l] = end ? 0 : frameCycle[l];
+      delay_timer[l] -= end & (delay_timer[l] > 0);
+      beeps[l] = end ? (sound_timer[l] == 1) : beeps[l];
+      sound_timer[l] -= end & (sound_timer[l] > 0);
+    }
+  }
+}
+
+template<unsigned int N>
+void Lockstep<N>::execute(std::uint16_t opcode, const Mask& a)
+{
+  std::uint8_t  x   = (opcode & 0x0F00) >> 8;
+  std::uint8_t  y   = (opcode & 0x00F0) >> 4;
+  std::uint8_t  nn  = (opcode & 0x00FF);
+  std::uint8_t  n   = (opcode & 0x000F);
+  std::uint16_t nnn = (opcode & 0x0FFF);
+
+  Lanes<std::uint8_t>& vx = V[x];
+  Lanes<std::uint8_t>& vy = V[y];
+  Lanes<std::uint8_t>& vf = V[0xF];
+
+  // lanes that move on to the next instruction, set by the cases below
+  bool advance = true;
+
+  switch (opcode & 0xF000) {
+  case 0x0000:
+    if (n == 0x0) {
+      for (auto& row : gfx)
+        for (unsigned int l = 0; l < N; l++)
+          row[l] &= static_cast<std::uint64_t>(a[l]) - 1;
+    } else if (n == 0xE) {
+      for (unsigned int l = 0; l < N; l++)
+        if (a[l]) {
+          --sp[l];
+          pc[l] = stack[sp[l] & 0xF][l];
+        }
+    } else {
+      advance = false;
+      for (unsigned int l = 0; l < N; l++)
+        illegal[l] |= a[l];
+    }
+    break;
+  case 0x1000:
+    advance = false;
+    for (unsigned int l = 0; l < N; l++)
+      pc[l] = pick<std::uint16_t>(a[l], nnn, pc[l]);
+    break;
+  case 0x2000:
+    advance = false;
+    for (unsigned int l = 0; l < N; l++)
+      if (a[l]) {
+        stack[sp[l] & 0xF][l] = pc[l];
+        ++sp[l];
+        pc[l] = nnn;
+      }
+    break;
+  case 0x3000:
+    for (unsigned int l = 0; l < N; l++)
+      pc[l] += (a[l] & (vx[l] == nn)) << 1;
+    break;
+  case 0x4000:
+    for (unsigned int l = 0; l < N; l++)
+      pc[l] += (a[l] & (vx[l] != nn)) << 1;
+    break;
+  case 0x5000:
+    for (unsigned int l = 0; l < N; l++)
+      pc[l] += (a[l] & (vx[l] == vy[l])) << 1;
+    break;
+  case 0x6000:
+    for (unsigned int l = 0; l < N; l++)
+      vx[l] = pick<std::uint8_t>(a[l], nn, vx[l]);
+    break;
+  case 0x7000:
+    for (unsigned int l = 0; l < N; l++)
+      vx[l] += pick<std::uint8_t>(a[l], nn, 0);
+    break;
+  case 0x8000:
+    // vf is written first and x or y may be 0xF, so every lane does the
+    // steps in the same order as the interpreter
+    switch (n) {
+    case 0x0:
+      for (unsigned int l = 0; l < N; l++)
+        vx[l] = pick(a[l], vy[l], vx[l]);
+      break;
+    case 0x1:
+      for (unsigned int l = 0; l < N; l++)
+        vx[l] |= pick<std::uint8_t>(a[l], vy[l], 0);
+      break;
+    case 0x2:
+      for (unsigned int l = 0; l < N; l++)
+        vx[l] &= pick<std::uint8_t>(a[l], vy[l], 0xFF);
+      break;
+    case 0x3:
+      for (unsigned int l = 0; l < N; l++)
+        vx[l] ^= pick<std::uint8_t>(a[l], vy[l], 0);
+      break;
+    case 0x4:
+      for (unsigned int l = 0; l < N; l++) {
+        std::uint8_t carry = vy[l] > (0xFF - vx[l]);
+        vf[l] = pick(a[l], carry, vf[l]);
+        vx[l] += pick<std::uint8_t>(a[l], vy[l], 0);
+      }
+      break;
+    case 0x5:
+      for (unsigned int l = 0; l < N; l++) {
+        std::uint8_t noborrow = vx[l] > vy[l];
+        vf[l] = pick(a[l], noborrow, vf[l]);
+        vx[l] -= pick<std::uint8_t>(a[l], vy[l], 0);
+      }
+      break;
+    case 0x6:
+      for (unsigned int l = 0; l < N; l++) {
+        std::uint8_t bit = vx[l] & 0x01;
+        vf[l] = pick(a[l], bit, vf[l]);
+        vx[l] = pick<std::uint8_t>(a[l], vx[l] >> 1, vx[l]);
+      }
+      break;
+    case 0x7:
+      for (unsigned int l = 0; l < N; l++) {
+        std::uint8_t noborrow = vy[l] > vx[l];
+        vf[l] = pick(a[l], noborrow, vf[l]);
+        vx[l] = pick<std::uint8_t>(a[l], vy[l] - vx[l], vx[l]);
+      }
+      break;
+    case 0xE:
+      for (unsigned int l = 0; l < N; l++) {
+        std::uint8_t bit = vx[l] >> 7;
+        vf[l] = pick(a[l], bit, vf[l]);
+        vx[l] = pick<std::uint8_t>(a[l], vx[l] << 1, vx[l]);
+      }
+      break;
+    default:
+      advance = false;
+      for (unsigned int l = 0; l < N; l++)
+        illegal[l] |= a[l];
+    }
+    break;
+  case 0x9000:
+    for (unsigned int l = 0; l < N; l++)
+      pc[l] += (a[l] & (vx[l] != vy[l])) << 1;
+    break;
+  case 0xA000:
+    for (unsigned int l = 0; l < N; l++)
+      I[l] = pick<std::uint16_t>(a[l], nnn, I[l]);
+    break;
+  case 0xB000:
+    advance = false;
+    for (unsigned int l = 0; l < N; l++)
+      pc[l] = pick<std::uint16_t>(a[l], nnn + V[0x0][l], pc[l]);
+    break;
+  case 0xC000:
+    for (unsigned int l = 0; l < N; l++)
+      if (a[l])
+        vx[l] = chip8::random(rng[l]) & nn;
+    break;
+  case 0xD000:
+    drawSprite(a, x, y, n);
+    break;
+  case 0xE000:
+    if (n == 0xE) {
+      for (unsigned int l = 0; l < N; l++)
+        pc[l] += (a[l] & (key[vx[l] & 0xF][l] != 0)) << 1;
+    } else if (n == 0x1) {
+      for (unsigned int l = 0; l < N; l++)
+        pc[l] += (a[l] & (key[vx[l] & 0xF][l] == 0)) << 1;
+    } else {
+      advance = false;
+      for (unsigned int l = 0; l < N; l++)
+        illegal[l] |= a[l];
+    }
+    break;
+  case 0xF000:
+    switch (nn) {
+    case 0x07:
+      for (unsigned int l = 0; l < N; l++)
+        vx[l] = pick(a[l], delay_timer[l], vx[l]);
+      break;
+    case 0x0A:
+      // lanes without a key pressed stay on the instruction
+      advance = false;
+      for (unsigned int l = 0; l < N; l++) {
+        if (!a[l])
+          continue;
+        bool pressed = false;
+        for (int i = 0; i < 16; i++)
+          if (key[i][l] != 0) {
+            pressed = true;
+            vx[l] = i;
+          }
+        if (pressed)
+          pc[l] += 2;
+      }
+      break;
+    case 0x15:
+      for (unsigned int l = 0; l < N; l++)
+        delay_timer[l] = pick(a[l], vx[l], delay_timer[l]);
+      break;
+    case 0x18:
+      for (unsigned int l = 0; l < N; l++)
+        sound_timer[l] = pick(a[l], vx[l], sound_timer[l]);
+      break;
+    case 0x1E:
+      for (unsigned int l = 0; l < N; l++) {
+        std::uint8_t overflow = I[l] + vx[l] > 0xFFF;
+        vf[l] = pick(a[l], overflow, vf[l]);
+        I[l] += pick<std::uint8_t>(a[l], vx[l], 0);
+      }
+      break;
+    case 0x29:
+      for (unsigned int l = 0; l < N; l++)
+        I[l] = pick<std::uint16_t>(a[l], vx[l] * 0x5, I[l]);
+      break;
+    case 0x33:
+      for (unsigned int l = 0; l < N; l++)
+        if (a[l]) {
+          memory[ I[l]      & 0xFFF][l] =  vx[l] / 100;
+          memory[(I[l] + 1) & 0xFFF][l] = (vx[l] / 10) % 10;
+          memory[(I[l] + 2) & 0xFFF][l] =  vx[l] % 10;
+        }
+      break;
+    case 0x55:
+      for (int i = 0; i <= x; i++)
+        for (unsigned int l = 0; l < N; l++)
+          if (a[l])
+            memory[(I[l] + i) & 0xFFF][l] = V[i][l];
+      break;
+    case 0x65:
+      for (int i = 0; i <= x; i++)
+        for (unsigned int l = 0; l < N; l++)
+          V[i][l] = pick(a[l], memory[(I[l] + i) & 0xFFF][l], V[i][l]);
+      break;
+    default:
+      advance = false;
+      for (unsigned int l = 0; l < N; l++)
+        illegal[l] |= a[l];
+    }
+    break;
+  }
+
+  if (advance)
+    for (unsigned int l = 0; l < N; l++)
+      pc[l] += a[l] << 1;
+}
+
+template<unsigned int N>
+void Lockstep<N>::drawSprite(const Mask& a, std::uint8_t x, std::uint8_t y,
+  std::uint8_t height)
+{
+  // same as chip8::DRW, a row at a time for every lane. the rows of the
+  // lanes that sit this one out are empty
+  Lanes<std::uint64_t> collision = {{}};
+  for (int yline = 0; yline < height; yline++)
+    for (unsigned int l = 0; l < N; l++) {
+      std::uint64_t sprite = chip8::spriteRow(
+        memory[(I[l] + yline) & 0xFFF][l], V[x][l]);
+      sprite &= -static_cast<std::uint64_t>(a[l]);
+
+      std::uint64_t& row = gfx[(V[y][l] + yline) % 32][l];
+      collision[l] |= row & sprite;
+      row ^= sprite;
+    }
+
+  for (unsigned int l = 0; l < N; l++)
+    V[0xF][l] = pick<std::uint8_t>(a[l], collision[l] != 0, V[0xF][l]);
+}
+
+template<unsigned int N>
+void Lockstep<N>::setCyclesPerFrame(unsigned int cycles)
+{
+  cyclesPerFrame = std::max(1u, cycles);
+  for (unsigned int l = 0; l < N; l++)
+    if (frameCycle[l] >= cyclesPerFrame)
+      frameCycle[l] = 0;
+}
+
+template<unsigned int N>
+unsigned int Lockstep<N>::getCyclesPerFrame() const
+{
+  return cyclesPerFrame;
+}
+
+template<unsigned int N>
+void Lockstep<N>::setKeys(unsigned int lane, std::uint16_t keys)
+{
+  for (int i = 0; i < 16; i++)
+    key[i][lane] = (keys >> i) & 1;
+}
+
+template<unsigned int N>
+void Lockstep<N>::seed(unsigned int lane, std::uint64_t value)
+{
+  rngSeed[lane] = value;
+  rng[lane]     = chip8::rngState(value);
+}
+
+template<unsigned int N>
+chip8::GfxMem Lockstep<N>::getGfxBuffer(unsigned int lane) const
+{
+  chip8::GfxMem rows;
+  for (int y = 0; y < 32; y++)
+    rows[y] = gfx[y][lane];
+
+  return rows;
+}
+
+template<unsigned int N>
+bool Lockstep<N>::illegalOpcode(unsigned int lane) const
+{
+  return illegal[lane] != 0;
+}
+
+template<unsigned int N>
+bool Lockstep<N>::beep(unsigned int lane) const
+{
+  return beeps[lane] != 0;
+}
+
+template<unsigned int N>
+std::uint64_t Lockstep<N>::stateHash(unsigned int lane) const
+{
+  std::uint64_t hash = fnvOffset;
+  fnv(hash, I[lane], 2);
+  fnv(hash, pc[lane], 2);
+  fnv(hash, sp[lane], 2);
+  fnv(hash, delay_timer[lane], 1);
+  fnv(hash, sound_timer[lane], 1);
+  fnv(hash, frameCycle[lane], 4);
+  for (auto& lanes : stack)
+    fnv(hash, lanes[lane], 2);
+  for (auto& lanes : memory)
+    fnv(hash, lanes[lane], 1);
+  for (auto& lanes : V)
+    fnv(hash, lanes[lane], 1);
+  for (auto& lanes : gfx)
+    fnv(hash, lanes[lane], 8);
+  fnv(hash, rng[lane], 8);
+
+  return hash;
+}
+
+template class Lockstep<8>;
+template class Lockstep<16>;
+template class Lockstep<32>;
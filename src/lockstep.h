@@ -0,0 +1,88 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "chip8.h"
+
+// N instances of the same rom run side by side, with every piece of state
+// stored lane by lane. an instruction is executed for all lanes that sit on
+// the same pc with the same opcode at once, in loops over the lanes the
+// compiler can vectorize. lanes that diverged are masked out and catch up
+// when their turn comes. instantiated for 8, 16 and 32 lanes
+template<unsigned int N>
+class Lockstep
+{
+public:
+  Lockstep();
+
+  // loads the same rom into every lane and resets them
+  bool loadGame(const std::uint8_t* data, std::size_t size);
+  void reset();
+
+  // runs every lane for the given amount of cycles
+  void runCycles(unsigned long cycles);
+
+  void setCyclesPerFrame(unsigned int);
+  unsigned int getCyclesPerFrame() const;
+
+  // per lane input, bit n is key n
+  void setKeys(unsigned int lane, std::uint16_t keys);
+
+  // same as chip8::seed() for one lane
+  void seed(unsigned int lane, std::uint64_t value);
+
+  chip8::GfxMem getGfxBuffer(unsigned int lane) const;
+  bool illegalOpcode(unsigned int lane) const;
+  bool beep(unsigned int lane) const;
+
+  // same as chip8::stateHash() for a machine in the lane's state
+  std::uint64_t stateHash(unsigned int lane) const;
+
+  static const unsigned int lanes = N;
+
+private:
+  template<typename T>
+  using Lanes = std::array<T, N>;
+  typedef Lanes<std::uint8_t> Mask;
+
+  void execute(std::uint16_t opcode, const Mask& active);
+  void drawSprite(const Mask& active, std::uint8_t x, std::uint8_t y,
+    std::uint8_t height);
+
+  // cpu variables
+  Lanes<std::uint16_t> I;
+  Lanes<std::uint16_t> pc;
+  Lanes<std::uint16_t> sp;
+
+  // timers, counted down once every cyclesPerFrame cycles of each lane
+  Lanes<std::uint8_t> delay_timer;
+  Lanes<std::uint8_t> sound_timer;
+  Lanes<unsigned int> frameCycle;
+  Lanes<std::uint8_t> beeps;
+  unsigned int cyclesPerFrame;
+
+  // memory, indexed [address][lane]
+  std::array<Lanes<std::uint16_t>, 16>   stack;
+  std::array<Lanes<std::uint8_t>,  4096> memory;
+  std::array<Lanes<std::uint8_t>,  16>   V;
+
+  // graphics memory, one row per word as in chip8
+  std::array<Lanes<std::uint64_t>, 32> gfx;
+
+  // input variables
+  std::array<Lanes<std::uint8_t>, 16> key;
+
+  // random number generators and what reset() restarts them from
+  Lanes<std::uint64_t> rng;
+  Lanes<std::uint64_t> rngSeed;
+
+  Lanes<std::uint8_t> illegal;
+
+  // cycles run by each lane in the current runCycles()
+  Lanes<unsigned long> done;
+};
+
+#endif /* LOCKSTEP_H */
@@ -1,23 +1,71 @@
 #include "mainwindow.h"
 
+#include <QColorDialog>
 #include <QFileDialog>
 #include <QString>
 
+#include "keymapdialog.h"
+#include "statsdialog.h"
+
 MainWindow::MainWindow(QWidget* parent) :
   QMainWindow(parent),
   ui(new Ui_MainWindow)
 {
   ui->setupUi(this);
 
-  ui->actiongroupClockRate->addAction(ui->actionSetClockRate30);
-  ui->actiongroupClockRate->addAction(ui->actionSetClockRate60);
-  ui->actiongroupClockRate->addAction(ui->actionSetClockRate120);
+  ui->actiongroupClockRate->addAction(ui->actionSetClockRate300);
+  ui->actiongroupClockRate->addAction(ui->actionSetClockRate600);
+  ui->actiongroupClockRate->addAction(ui->actionSetClockRate1200);
+
+  ui->actiongroupStateSlot->addAction(ui->actionStateSlot1);
+  ui->actiongroupStateSlot->addAction(ui->actionStateSlot2);
+  ui->actiongroupStateSlot->addAction(ui->actionStateSlot3);
+  ui->actiongroupStateSlot->addAction(ui->actionStateSlot4);
+
+  ui->actiongroupEngine->addAction(ui->actionEngineInterpreter);
+  ui->actiongroupEngine->addAction(ui->actionEngineJit);
+  ui->actionEngineJit->setEnabled(
+    chip8::engineSupported(chip8::Engine::Jit));
 
   connect(ui->actionClose, SIGNAL(triggered()), SLOT(Exit()));
   connect(ui->actionOpen, SIGNAL(triggered()), SLOT(Open()));
   connect(ui->actionReload, SIGNAL(triggered()), SLOT(Reload()));
+  connect(ui->actionSaveState, SIGNAL(triggered()), SLOT(SaveState()));
+  connect(ui->actionLoadState, SIGNAL(triggered()), SLOT(LoadState()));
+  connect(ui->actionRecordMovie, SIGNAL(triggered()), SLOT(RecordMovie()));
+  connect(ui->actionStopMovie, SIGNAL(triggered()), SLOT(StopMovie()));
+  connect(ui->actionPlayMovie, SIGNAL(triggered()), SLOT(PlayMovie()));
   connect(ui->actiongroupClockRate, SIGNAL(triggered(QAction*)),
     SLOT(FPSActionTriggered(QAction*)));
+  connect(ui->actiongroupEngine, SIGNAL(triggered(QAction*)),
+    SLOT(EngineActionTriggered(QAction*)));
+  connect(ui->actionForegroundColor, SIGNAL(triggered()),
+    SLOT(ForegroundColor()));
+  connect(ui->actionBackgroundColor, SIGNAL(triggered()),
+    SLOT(BackgroundColor()));
+  connect(ui->actionKeys, SIGNAL(triggered()), SLOT(Keys()));
+
+  ui->actiongroupFastForward->addAction(ui->actionFastForward2);
+  ui->actiongroupFastForward->addAction(ui->actionFastForward4);
+  ui->actiongroupFastForward->addAction(ui->actionFastForward8);
+  ui->actiongroupFastForward->addAction(ui->actionFastForward16);
+  ui->actiongroupFastForward->addAction(ui->actionFastForward32);
+  ui->actiongroupFastForward->addAction(ui->actionFastForward64);
+  ui->actiongroupFastForward->addAction(ui->actionFastForwardUnlimited);
+
+  connect(ui->actionFastForward, SIGNAL(toggled(bool)),
+    SLOT(FastForwardToggled(bool)));
+  connect(ui->actiongroupFastForward, SIGNAL(triggered(QAction*)),
+    SLOT(FastForwardSpeedTriggered(QAction*)));
+
+  // achieved speed, measured twice a second
+  speedLabel = new QLabel(this);
+  ui->statusBar->addPermanentWidget(speedLabel);
+  connect(&speedTimer, SIGNAL(timeout()), SLOT(ShowSpeed()));
+  speedTimer.start(500);
+
+  ui->actionOpcodeStats->setEnabled(chip8::statsEnabled);
+  connect(ui->actionOpcodeStats, SIGNAL(triggered()), SLOT(OpcodeStats()));
 }
 
 MainWindow::~MainWindow() {
@@ -31,18 +79,101 @@ void MainWindow::Exit() {
 void MainWindow::Open() {
   QString fileName = QFileDialog::getOpenFileName(this, tr("Open File"),
     "", tr("Files (*.*)"));
-  emu()->loadFile(fileName.toStdString());
+  if (!fileName.isEmpty() && !emu()->loadFile(fileName.toStdString()))
+    ui->statusBar->showMessage(tr("Could not load %1").arg(fileName), 5000);
 }
 
 void MainWindow::Reload() {
   emu()->reloadFile();
 }
 
+void MainWindow::SaveState() {
+  emu()->saveState(stateSlot());
+}
+
+void MainWindow::LoadState() {
+  emu()->loadState(stateSlot());
+}
+
+void MainWindow::RecordMovie() {
+  emu()->startRecording();
+}
+
+void MainWindow::StopMovie() {
+  emu()->stopRecording();
+}
+
+void MainWindow::PlayMovie() {
+  emu()->playMovie();
+}
+
+int MainWindow::stateSlot() const {
+  if (ui->actionStateSlot2->isChecked()) return 2;
+  if (ui->actionStateSlot3->isChecked()) return 3;
+  if (ui->actionStateSlot4->isChecked()) return 4;
+  return 1;
+}
+
 void MainWindow::FPSActionTriggered(QAction* action) {
-  unsigned int freq = 60;
-  if (action == ui->actionSetClockRate30 ) freq = 30;
-  if (action == ui->actionSetClockRate60 ) freq = 60;
-  if (action == ui->actionSetClockRate120) freq = 120;
+  unsigned int freq = 600;
+  if (action == ui->actionSetClockRate300 ) freq = 300;
+  if (action == ui->actionSetClockRate600 ) freq = 600;
+  if (action == ui->actionSetClockRate1200) freq = 1200;
 
   emu()->setClockRate(freq);
 }
+
+void MainWindow::EngineActionTriggered(QAction* action) {
+  chip8::Engine engine = chip8::Engine::Interpreter;
+  if (action == ui->actionEngineJit) engine = chip8::Engine::Jit;
+
+  emu()->setEngine(engine);
+}
+
+void MainWindow::ForegroundColor() {
+  const sf::Color& on = emu()->onColor();
+  QColor color = QColorDialog::getColor(QColor(on.r, on.g, on.b), this);
+  if (color.isValid())
+    emu()->setColors(sf::Color(color.red(), color.green(), color.blue()),
+      emu()->offColor());
+}
+
+void MainWindow::BackgroundColor() {
+  const sf::Color& off = emu()->offColor();
+  QColor color = QColorDialog::getColor(QColor(off.r, off.g, off.b), this);
+  if (color.isValid())
+    emu()->setColors(emu()->onColor(),
+      sf::Color(color.red(), color.green(), color.blue()));
+}
+
+void MainWindow::Keys() {
+  KeyMapDialog dialog(emu(), this);
+  dialog.exec();
+}
+
+void MainWindow::FastForwardToggled(bool on) {
+  emu()->setFastForward(on);
+}
+
+void MainWindow::FastForwardSpeedTriggered(QAction* action) {
+  unsigned int multiple = 8;
+  if (action == ui->actionFastForward2        ) multiple = 2;
+  if (action == ui->actionFastForward4        ) multiple = 4;
+  if (action == ui->actionFastForward8        ) multiple = 8;
+  if (action == ui->actionFastForward16       ) multiple = 16;
+  if (action == ui->actionFastForward32       ) multiple = 32;
+  if (action == ui->actionFastForward64       ) multiple = 64;
+  if (action == ui->actionFastForwardUnlimited) multiple = 0;
+
+  emu()->setFastForwardSpeed(multiple);
+}
+
+void MainWindow::ShowSpeed() {
+  speedLabel->setText(tr("%1x").arg(emu()->measureSpeed(), 0, 'f', 1));
+}
+
+void MainWindow::OpcodeStats() {
+  StatsDialog* dialog = new StatsDialog(emu(), this);
+  dialog->setAttribute(Qt::WA_DeleteOnClose);
+  dialog->show();
+}
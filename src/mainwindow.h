@@ -1,7 +1,9 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include <QLabel>
 #include <QMainWindow>
+#include <QTimer>
 
 #include "emulatorcanvas.h"
 #include "ui_mainwindow.h"
@@ -20,10 +22,27 @@ private slots:
   void Exit();
   void Open();
   void Reload();
+  void SaveState();
+  void LoadState();
+  void RecordMovie();
+  void StopMovie();
+  void PlayMovie();
   void FPSActionTriggered(QAction*);
+  void EngineActionTriggered(QAction*);
+  void ForegroundColor();
+  void BackgroundColor();
+  void Keys();
+  void OpcodeStats();
+  void FastForwardToggled(bool);
+  void FastForwardSpeedTriggered(QAction*);
+  void ShowSpeed();
 
 private:
+  int stateSlot() const;
+
   Ui_MainWindow* ui;
+  QLabel* speedLabel;
+  QTimer speedTimer;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,237 @@
+#include "movie.h"
+#include "fnv.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iterator>
+
+// file layout, multi-byte values little endian:
+//   "SC8M", version (2), rom hash (8), seed (8), cycles per frame (4),
+//   length (8), event count (4), then per event the cycles since the
+//   previous event as a base 128 varint and the keys (2)
+
+namespace {
+
+void put(std::vector<std::uint8_t>& out, std::uint64_t value, int bytes)
+{
+  for (int i = 0; i < bytes; i++)
+    out.push_back((value >> (i * 8)) & 0xFF);
+}
+
+void putVarint(std::vector<std::uint8_t>& out, std::uint64_t value)
+{
+  while (value >= 0x80) {
+    out.push_back((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  out.push_back(value);
+}
+
+// reads from a buffer, pos runs past end on malformed input
+class Reader
+{
+public:
+  Reader(const std::vector<std::uint8_t>& in) : in(in), pos(0) { }
+
+  std::uint64_t get(int bytes)
+  {
+    std::uint64_t value = 0;
+    for (int i = 0; i < bytes; i++, pos++)
+      if (pos < in.size())
+        value |= static_cast<std::uint64_t>(in[pos]) << (i * 8);
+    return value;
+  }
+
+  std::uint64_t getVarint()
+  {
+    std::uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7, pos++) {
+      if (pos >= in.size())
+        break;
+      value |= static_cast<std::uint64_t>(in[pos] & 0x7F) << shift;
+      if (!(in[pos] & 0x80)) {
+        pos++;
+        return value;
+      }
+    }
+    pos = in.size() + 1;
+    return value;
+  }
+
+  bool ok() const { return pos <= in.size(); }
+  bool done() const { return pos == in.size(); }
+
+private:
+  const std::vector<std::uint8_t>& in;
+  std::size_t pos;
+};
+
+const char magic[4] = {'S', 'C', '8', 'M'};
+
+}
+
+const std::uint16_t Movie::VERSION;
+
+Movie::Movie() :
+  romHash(0),
+  seed(0),
+  cyclesPerFrame(0),
+  length(0)
+{
+}
+
+void Movie::start(const std::uint8_t* rom, std::size_t size,
+  std::uint64_t seed, unsigned int cyclesPerFrame)
+{
+  romHash = hashRom(rom, size);
+  this->seed = seed;
+  this->cyclesPerFrame = cyclesPerFrame;
+  length = 0;
+  input.clear();
+}
+
+void Movie::record(std::uint64_t cycle, std::uint16_t keys)
+{
+  // a later change on the same cycle replaces the earlier one
+  if (!input.empty() && input.back().cycle == cycle)
+    input.pop_back();
+
+  // the session starts with nothing pressed
+  std::uint16_t held = input.empty() ? 0 : input.back().keys;
+  if (keys != held)
+    input.push_back(InputEvent{cycle, keys});
+}
+
+void Movie::finish(std::uint64_t cycle)
+{
+  length = cycle;
+}
+
+bool Movie::save(const std::string& filename) const
+{
+  std::vector<std::uint8_t> out(magic, magic + 4);
+  put(out, VERSION, 2);
+  put(out, romHash, 8);
+  put(out, seed, 8);
+  put(out, cyclesPerFrame, 4);
+  put(out, length, 8);
+  put(out, input.size(), 4);
+
+  std::uint64_t cycle = 0;
+  for (const InputEvent& event : input) {
+    putVarint(out, event.cycle - cycle);
+    put(out, event.keys, 2);
+    cycle = event.cycle;
+  }
+
+  std::ofstream file(filename, std::ios::binary);
+  file.write(reinterpret_cast<const char*>(out.data()), out.size());
+  return file.good();
+}
+
+bool Movie::load(const std::string& filename)
+{
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open()) return false;
+
+  std::vector<std::uint8_t> in((std::istreambuf_iterator<char>(file)),
+    std::istreambuf_iterator<char>());
+  if (in.size() < 4 || !std::equal(magic, magic + 4, in.begin()))
+    return false;
+
+  Reader reader(in);
+  reader.get(4);
+  if (reader.get(2) != VERSION)
+    return false;
+
+  Movie movie;
+  movie.romHash        = reader.get(8);
+  movie.seed           = reader.get(8);
+  movie.cyclesPerFrame = reader.get(4);
+  movie.length         = reader.get(8);
+
+  std::uint64_t count = reader.get(4);
+  std::uint64_t cycle = 0;
+  for (std::uint64_t i = 0; i < count && reader.ok(); i++) {
+    cycle += reader.getVarint();
+    std::uint16_t keys = reader.get(2);
+    movie.input.push_back(InputEvent{cycle, keys});
+  }
+
+  if (!reader.done())
+    return false;
+
+  *this = movie;
+  return true;
+}
+
+bool Movie::matches(const std::uint8_t* rom, std::size_t size) const
+{
+  return hashRom(rom, size) == romHash;
+}
+
+std::uint64_t Movie::hashRom(const std::uint8_t* rom, std::size_t size)
+{
+  std::uint64_t hash = fnvOffset;
+  for (std::size_t i = 0; i < size; i++)
+    fnv(hash, rom[i], 1);
+  fnv(hash, size, 8);
+
+  return hash;
+}
+
+MoviePlayer::MoviePlayer(const Movie& movie) :
+  movie(movie),
+  cycle(0),
+  next(0)
+{
+}
+
+bool MoviePlayer::begin(chip8& emu, const std::uint8_t* rom,
+  std::size_t size)
+{
+  if (!movie.matches(rom, size))
+    return false;
+
+  emu.seed(movie.seed);
+  if (!emu.loadGame(rom, size))
+    return false;
+  emu.setCyclesPerFrame(movie.cyclesPerFrame);
+
+  cycle = 0;
+  next  = 0;
+  return true;
+}
+
+chip8::RunResult MoviePlayer::run(chip8& emu, std::uint8_t stopOn)
+{
+  chip8::RunResult total{0, chip8::EVENT_NONE};
+
+  while (cycle < movie.length) {
+    // press the keys of every event that is due
+    for (; next < movie.input.size() && movie.input[next].cycle <= cycle;
+         ++next)
+    {
+      std::array<std::uint8_t, 16> keys;
+      for (int i = 0; i < 16; i++)
+        keys[i] = (movie.input[next].keys >> i) & 1;
+      emu.setKeys(keys);
+    }
+
+    // run up to the next event or the end
+    std::uint64_t until = movie.length;
+    if (next < movie.input.size())
+      until = std::min(until, movie.input[next].cycle);
+
+    chip8::RunResult result = emu.runCycles(until - cycle, stopOn);
+    cycle += result.cycles;
+    total.cycles += result.cycles;
+    total.events |= result.events;
+
+    if (result.events & stopOn)
+      break;
+  }
+
+  return total;
+}
@@ -0,0 +1,70 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "chip8.h"
+
+// keys held from a given cycle on, bit n is key n
+struct InputEvent
+{
+  std::uint64_t cycle;
+  std::uint16_t keys;
+};
+
+// the input of a session together with everything else needed to play it
+// back exactly: the rom, the seed and the cycles per frame it started
+// with. only changes of the keys are stored
+class Movie
+{
+public:
+  Movie();
+
+  // starts a new recording, the session has to begin with loading the
+  // rom into a machine seeded with seed
+  void start(const std::uint8_t* rom, std::size_t size, std::uint64_t seed,
+    unsigned int cyclesPerFrame);
+  void record(std::uint64_t cycle, std::uint16_t keys);
+  void finish(std::uint64_t cycle);
+
+  bool save(const std::string&) const;
+  bool load(const std::string&);
+
+  bool matches(const std::uint8_t* rom, std::size_t size) const;
+  static std::uint64_t hashRom(const std::uint8_t* rom, std::size_t size);
+
+  static const std::uint16_t VERSION = 1;
+
+  std::uint64_t romHash;
+  std::uint64_t seed;
+  unsigned int cyclesPerFrame;
+  std::uint64_t length;           // cycles in the session
+  std::vector<InputEvent> input;  // sorted by cycle
+};
+
+// runs a machine with the input of a movie
+class MoviePlayer
+{
+public:
+  MoviePlayer(const Movie&);
+
+  // loads the rom the way the recording started, false if it isn't the
+  // rom the movie was recorded with
+  bool begin(chip8&, const std::uint8_t* rom, std::size_t size);
+
+  // runs until the end of the movie or an event in stopOn
+  chip8::RunResult run(chip8&, std::uint8_t stopOn = chip8::EVENT_NONE);
+
+  bool finished() const { return cycle >= movie.length; }
+  std::uint64_t position() const { return cycle; }
+
+private:
+  const Movie& movie;
+  std::uint64_t cycle;
+  std::size_t next;
+};
+
+#endif /* MOVIE_H */
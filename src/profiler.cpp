@@ -0,0 +1,106 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+namespace {
+
+const std::size_t addresses = 4096;
+
+// entries of the chip8 stack
+const std::uint16_t maxDepth = 16;
+
+}
+
+Profiler::Profiler()
+{
+  clear();
+}
+
+void Profiler::clear()
+{
+  nodes.assign(1, Node{0x200, 0, {}, {}});
+  current = 0;
+  depth   = 0;
+  total   = 0;
+}
+
+// a CALL moved to pc with the stack one deeper, a RET returned to the
+// caller. a deeper stack than ever seen, e.g. when attached in the middle of
+// a subroutine, is followed as well as a program resetting sp can be
+void Profiler::follow(std::uint16_t sp, std::uint16_t pc)
+{
+  // a RET with an empty stack wraps sp around, there is no call chain to
+  // follow past the stack's end, so counting starts over at the root
+  if (sp > maxDepth) {
+    current = 0;
+    depth = 0;
+    return;
+  }
+
+  for (; depth > sp; --depth)
+    current = nodes[current].parent;
+  for (; depth < sp; ++depth)
+    current = child(current, pc & 0xFFF);
+}
+
+std::size_t Profiler::child(std::size_t parent, std::uint16_t addr)
+{
+  auto found = nodes[parent].children.find(addr);
+  if (found != nodes[parent].children.end())
+    return found->second;
+
+  std::size_t index = nodes.size();
+  nodes.push_back(Node{addr, parent, {}, {}});
+  nodes[parent].children[addr] = index;
+  return index;
+}
+
+void Profiler::write(std::ostream& out, bool pcs) const
+{
+  for (std::size_t i = 0; i < nodes.size(); i++) {
+    // the call chain, from the outermost frame in
+    std::vector<std::uint16_t> chain;
+    for (std::size_t n = i; n != 0; n = nodes[n].parent)
+      chain.push_back(nodes[n].addr);
+
+    std::ostringstream frames;
+    frames << "main" << std::hex;
+    for (auto addr = chain.rbegin(); addr != chain.rend(); ++addr)
+      frames << ";sub_" << std::setw(3) << std::setfill('0') << *addr;
+
+    std::uint64_t self = 0;
+    for (const auto& count : nodes[i].counts) {
+      self += count.second;
+      if (pcs)
+        out << frames.str() << ";pc_" << std::hex << std::setw(3)
+            << std::setfill('0') << count.first << std::dec << ' '
+            << count.second << '\n';
+    }
+
+    if (!pcs && self > 0)
+      out << frames.str() << ' ' << self << '\n';
+  }
+}
+
+std::vector<std::pair<std::uint16_t, std::uint64_t>> Profiler::hotspots() const
+{
+  std::vector<std::uint64_t> counts(addresses);
+  for (const Node& node : nodes)
+    for (const auto& count : node.counts)
+      counts[count.first] += count.second;
+
+  std::vector<std::pair<std::uint16_t, std::uint64_t>> spots;
+  for (std::size_t addr = 0; addr < addresses; addr++)
+    if (counts[addr] > 0)
+      spots.emplace_back(addr, counts[addr]);
+
+  std::stable_sort(spots.begin(), spots.end(),
+    [](const std::pair<std::uint16_t, std::uint64_t>& a,
+       const std::pair<std::uint16_t, std::uint64_t>& b) {
+      return a.second > b.second;
+    });
+  return spots;
+}
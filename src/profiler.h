@@ -0,0 +1,61 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+// exact per pc profile of a running machine. every executed instruction is
+// counted under its address and the chain of subroutines it was called
+// through, which follows the CALLs and RETs by watching the stack pointer.
+// attach with chip8::setProfiler()
+class Profiler
+{
+public:
+  Profiler();
+
+  // called by chip8 after running the instruction at addr, with the stack
+  // pointer and pc it left behind
+  void record(std::uint16_t addr, std::uint16_t sp, std::uint16_t pc)
+  {
+    ++nodes[current].counts[addr & 0xFFF];
+    ++total;
+    if (sp != depth)
+      follow(sp, pc);
+  }
+
+  // collapsed stacks as read by flamegraph.pl and compatible tools, one
+  // "main;sub_2a4;sub_310;pc_316 count" line per address and call chain.
+  // without pcs an instruction only counts for the subroutine it is in
+  void write(std::ostream&, bool pcs = true) const;
+
+  // executed instructions per address over all call chains, most
+  // executed first
+  std::vector<std::pair<std::uint16_t, std::uint64_t>> hotspots() const;
+
+  std::uint64_t instructions() const { return total; }
+  void clear();
+
+private:
+  // one call chain, entered through a CALL to addr from its parent
+  struct Node
+  {
+    std::uint16_t addr;
+    std::size_t parent;
+    std::map<std::uint16_t, std::size_t> children;
+    std::map<std::uint16_t, std::uint64_t> counts;  // by address, sparse
+  };
+
+  void follow(std::uint16_t sp, std::uint16_t pc);
+  std::size_t child(std::size_t parent, std::uint16_t addr);
+
+  std::vector<Node> nodes;              // nodes[0] is the rom itself
+  std::size_t current;
+  std::uint16_t depth;
+  std::uint64_t total;
+};
+
+#endif /* PROFILER_H */
@@ -67,6 +67,15 @@ void QSFMLCanvas::paintEvent(QPaintEvent*)
   render.display();
 }
 
+void QSFMLCanvas::resizeEvent(QResizeEvent* event)
+{
+  // keep the sfml window the size of the widget, the view is left alone
+  // so the contents are stretched to fit
+  if (myInitialized)
+    render.setSize(sf::Vector2u(event->size().width(),
+      event->size().height()));
+}
+
 void QSFMLCanvas::OnInit()
 {
 }
@@ -3,6 +3,7 @@
 
 #include <QFocusEvent>
 #include <QPaintEngine>
+#include <QResizeEvent>
 #include <QTimer>
 #include <QWidget>
 #include <SFML/Graphics.hpp>
@@ -24,6 +25,7 @@ private:
 
   void showEvent(QShowEvent*);
   void paintEvent(QPaintEvent*);
+  void resizeEvent(QResizeEvent*);
   QPaintEngine* paintEngine() const;
 
   virtual void focusInEvent(QFocusEvent*);
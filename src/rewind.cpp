@@ -0,0 +1,185 @@
+#include "rewind.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const std::size_t stateSize = sizeof(chip8::SaveState);
+
+// a literal run ends in front of this many zero bytes
+const std::size_t minZeroRun = 4;
+
+void put16(std::vector<std::uint8_t>& out, std::size_t value)
+{
+  out.push_back(value & 0xFF);
+  out.push_back(value >> 8);
+}
+
+std::size_t get16(const std::uint8_t* in)
+{
+  return in[0] | (in[1] << 8);
+}
+
+// calls run(zeros, offset, length) for every pair of a zero run and the
+// literal run at offset following it
+template<typename Fn>
+void forEachRun(const std::uint8_t* x, Fn run)
+{
+  std::size_t i = 0;
+  while (i < stateSize) {
+    std::size_t zeros = 0;
+    while (i + zeros < stateSize && x[i + zeros] == 0)
+      ++zeros;
+    i += zeros;
+    if (i == stateSize) {
+      // trailing zeros are implied
+      break;
+    }
+
+    std::size_t length = 0;
+    while (i + length < stateSize) {
+      std::size_t run = 0;
+      while (run < minZeroRun && i + length + run < stateSize &&
+             x[i + length + run] == 0)
+        ++run;
+      if (run == minZeroRun || i + length + run == stateSize)
+        break;
+      length += run + 1;
+    }
+
+    run(zeros, i, length);
+    i += length;
+  }
+}
+
+// state xor base as pairs of a zero run and a literal run, each preceded
+// by its length. a null base is all zeros. out is sized up front, so it
+// is allocated once and with no spare capacity
+void encode(const std::uint8_t* state, const std::uint8_t* base,
+  std::vector<std::uint8_t>& out)
+{
+  std::uint8_t x[stateSize];
+  for (std::size_t i = 0; i < stateSize; i++)
+    x[i] = base ? state[i] ^ base[i] : state[i];
+
+  std::size_t size = 0;
+  forEachRun(x, [&](std::size_t, std::size_t, std::size_t length) {
+    size += 4 + length;
+  });
+
+  out.clear();
+  out.reserve(size);
+  forEachRun(x, [&](std::size_t zeros, std::size_t at, std::size_t length) {
+    put16(out, zeros);
+    put16(out, length);
+    out.insert(out.end(), x + at, x + at + length);
+  });
+}
+
+void decode(const std::vector<std::uint8_t>& in, const std::uint8_t* base,
+  std::uint8_t* state)
+{
+  if (base)
+    std::memcpy(state, base, stateSize);
+  else
+    std::memset(state, 0, stateSize);
+
+  std::size_t i = 0;
+  for (std::size_t pos = 0; pos + 4 <= in.size();) {
+    i += get16(&in[pos]);
+    std::size_t length = get16(&in[pos + 2]);
+    pos += 4;
+
+    for (std::size_t j = 0; j < length; j++)
+      state[i + j] ^= in[pos + j];
+    i += length;
+    pos += length;
+  }
+}
+
+}
+
+Rewind::Rewind(std::size_t budget, unsigned int keyframeInterval) :
+  budget(budget),
+  keyframeInterval(std::max(1u, keyframeInterval)),
+  used(0),
+  keyframes(0),
+  sinceKeyframe(0)
+{
+}
+
+void Rewind::push(const chip8::SaveState& state)
+{
+  const std::uint8_t* bytes = reinterpret_cast<const std::uint8_t*>(&state);
+
+  // encoded straight into the new entry, this runs every frame
+  bool key = keyframes == 0 || sinceKeyframe + 1 >= keyframeInterval;
+  entries.push_back(Entry{key, std::vector<std::uint8_t>()});
+  std::vector<std::uint8_t>& data = entries.back().data;
+  if (key) {
+    encode(bytes, nullptr, data);
+    keyframe = state;
+    sinceKeyframe = 0;
+    ++keyframes;
+  } else {
+    encode(bytes, reinterpret_cast<const std::uint8_t*>(&keyframe), data);
+    ++sinceKeyframe;
+  }
+
+  used += sizeof(Entry) + data.capacity();
+
+  while (used > budget && keyframes > 1)
+    dropOldest();
+}
+
+bool Rewind::pop(chip8::SaveState& state)
+{
+  if (entries.empty())
+    return false;
+
+  Entry& newest = entries.back();
+  std::uint8_t* bytes = reinterpret_cast<std::uint8_t*>(&state);
+
+  if (!newest.keyframe) {
+    decode(newest.data, reinterpret_cast<std::uint8_t*>(&keyframe), bytes);
+    --sinceKeyframe;
+  } else {
+    decode(newest.data, nullptr, bytes);
+    --keyframes;
+  }
+
+  used -= sizeof(Entry) + newest.data.capacity();
+  bool wasKeyframe = newest.keyframe;
+  entries.pop_back();
+
+  // the keyframe before is the base of the states left at the end
+  if (wasKeyframe && keyframes > 0) {
+    auto it = entries.end();
+    sinceKeyframe = 0;
+    while (!(--it)->keyframe)
+      ++sinceKeyframe;
+    decode(it->data, nullptr, reinterpret_cast<std::uint8_t*>(&keyframe));
+  }
+
+  return true;
+}
+
+void Rewind::clear()
+{
+  entries.clear();
+  used = 0;
+  keyframes = 0;
+  sinceKeyframe = 0;
+}
+
+// drops the oldest keyframe together with the states depending on it
+void Rewind::dropOldest()
+{
+  do {
+    used -= sizeof(Entry) + entries.front().data.capacity();
+    entries.pop_front();
+  } while (!entries.empty() && !entries.front().keyframe);
+
+  --keyframes;
+}
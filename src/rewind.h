@@ -0,0 +1,52 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "chip8.h"
+
+// history of save states for stepping backwards, newest last. a state is
+// stored as the run-length coded xor against the keyframe before it, a
+// keyframe as the run-length coded state itself. the oldest keyframes and
+// their states are dropped to stay within the memory budget
+class Rewind
+{
+public:
+  Rewind(std::size_t budget = 4 * 1024 * 1024,
+    unsigned int keyframeInterval = 60);
+
+  void push(const chip8::SaveState&);
+
+  // removes the newest state and returns it in state, false if empty
+  bool pop(chip8::SaveState& state);
+
+  void clear();
+  std::size_t size() const { return entries.size(); }
+  // bytes held by the entries, counting the capacity of their data
+  std::size_t memoryUsed() const { return used; }
+
+private:
+  struct Entry
+  {
+    bool keyframe;
+    std::vector<std::uint8_t> data;
+  };
+
+  void dropOldest();
+
+  std::size_t budget;
+  unsigned int keyframeInterval;
+
+  std::deque<Entry> entries;
+  std::size_t used;
+  std::size_t keyframes;
+
+  // the newest keyframe and the amount of states stored after it
+  chip8::SaveState keyframe;
+  unsigned int sinceKeyframe;
+};
+
+#endif /* REWIND_H */
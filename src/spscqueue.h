@@ -0,0 +1,81 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// lock-free ring buffer from one producer thread to one consumer thread.
+// Capacity has to be a power of two. neither side ever waits, push() fails
+// when full and pop() when empty
+template<typename T, std::size_t Capacity>
+class SpscQueue
+{
+  static_assert((Capacity & (Capacity - 1)) == 0,
+    "the capacity must be a power of two");
+
+public:
+  SpscQueue() :
+    buffer(),
+    head(0),
+    tail(0)
+  {
+  }
+
+  // producer side, copies as many of the count values as fit and returns
+  // how many that were
+  std::size_t push(const T* values, std::size_t count)
+  {
+    std::size_t t = tail.load(std::memory_order_relaxed);
+    std::size_t free = Capacity - (t - head.load(std::memory_order_acquire));
+    if (count > free)
+      count = free;
+
+    for (std::size_t i = 0; i < count; i++)
+      buffer[(t + i) & (Capacity - 1)] = values[i];
+    tail.store(t + count, std::memory_order_release);
+    return count;
+  }
+
+  bool push(const T& value)
+  {
+    return push(&value, 1) == 1;
+  }
+
+  // consumer side, takes up to count values and returns how many it took
+  std::size_t pop(T* values, std::size_t count)
+  {
+    std::size_t h = head.load(std::memory_order_relaxed);
+    std::size_t used = tail.load(std::memory_order_acquire) - h;
+    if (count > used)
+      count = used;
+
+    for (std::size_t i = 0; i < count; i++)
+      values[i] = buffer[(h + i) & (Capacity - 1)];
+    head.store(h + count, std::memory_order_release);
+    return count;
+  }
+
+  bool pop(T& value)
+  {
+    return pop(&value, 1) == 1;
+  }
+
+  // exact on either side when the other one is idle, otherwise a snapshot
+  std::size_t size() const
+  {
+    return tail.load(std::memory_order_acquire) -
+      head.load(std::memory_order_acquire);
+  }
+
+  static const std::size_t capacity = Capacity;
+
+private:
+  std::array<T, Capacity> buffer;
+
+  // positions count up forever and are wrapped when indexing
+  std::atomic<std::size_t> head;
+  std::atomic<std::size_t> tail;
+};
+
+#endif /* SPSCQUEUE_H */
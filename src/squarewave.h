@@ -0,0 +1,40 @@
+#ifndef SQUAREWAVE_H
+#define SQUAREWAVE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// the buzzer, a square wave that keeps its phase across calls so the tone
+// does not click between frames
+class SquareWave
+{
+public:
+  SquareWave(unsigned int sampleRate, unsigned int frequency,
+    std::int16_t amplitude) :
+    sampleRate(sampleRate),
+    frequency(frequency),
+    amplitude(amplitude),
+    phase(0)
+  {
+  }
+
+  // count samples of the tone, or of silence when off
+  void generate(bool on, std::int16_t* out, std::size_t count)
+  {
+    for (std::size_t i = 0; i < count; i++) {
+      // phase runs over one period in steps of frequency
+      out[i] = !on ? 0 : phase < sampleRate / 2 ? amplitude : -amplitude;
+      phase += frequency;
+      if (phase >= sampleRate)
+        phase -= sampleRate;
+    }
+  }
+
+private:
+  unsigned int sampleRate;
+  unsigned int frequency;
+  std::int16_t amplitude;
+  unsigned int phase;
+};
+
+#endif /* SQUAREWAVE_H */
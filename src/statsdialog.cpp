@@ -0,0 +1,61 @@
+#include "statsdialog.h"
+
+#include <QHeaderView>
+#include <QPushButton>
+#include <QString>
+#include <QVBoxLayout>
+
+StatsDialog::StatsDialog(EmulatorCanvas* emulator, QWidget* parent) :
+  QDialog(parent),
+  emulator(emulator),
+  table(new QTableWidget(chip8::HANDLERS, 2, this)),
+  drawTime(new QLabel(this))
+{
+  setWindowTitle(tr("Opcode statistics"));
+
+  table->setHorizontalHeaderLabels(QStringList() << tr("Executed")
+    << tr("Share"));
+  table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  for (unsigned int i = 0; i < chip8::HANDLERS; i++) {
+    table->setVerticalHeaderItem(i,
+      new QTableWidgetItem(chip8::handlerNames[i]));
+    table->setItem(i, 0, new QTableWidgetItem());
+    table->setItem(i, 1, new QTableWidgetItem());
+  }
+
+  QPushButton* reset = new QPushButton(tr("Reset"), this);
+
+  QVBoxLayout* layout = new QVBoxLayout(this);
+  layout->addWidget(table);
+  layout->addWidget(drawTime);
+  layout->addWidget(reset);
+
+  connect(reset, SIGNAL(clicked()), SLOT(clear()));
+  connect(&timer, SIGNAL(timeout()), SLOT(refresh()));
+  timer.start(500);
+  refresh();
+}
+
+void StatsDialog::refresh()
+{
+  chip8::Stats stats = emulator->stats();
+
+  std::uint64_t total = 0;
+  for (std::uint64_t count : stats.executed)
+    total += count;
+
+  for (unsigned int i = 0; i < chip8::HANDLERS; i++) {
+    double share = total > 0 ? 100.0 * stats.executed[i] / total : 0;
+    table->item(i, 0)->setText(QString::number(stats.executed[i]));
+    table->item(i, 1)->setText(QString::number(share, 'f', 2) + "%");
+  }
+
+  drawTime->setText(tr("Time in DRW: %1 ms")
+    .arg(stats.drawNanoseconds / 1e6, 0, 'f', 3));
+}
+
+void StatsDialog::clear()
+{
+  emulator->resetStats();
+  refresh();
+}
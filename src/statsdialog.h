@@ -0,0 +1,30 @@
+#ifndef STATSDIALOG_H
+#define STATSDIALOG_H
+
+#include <QDialog>
+#include <QLabel>
+#include <QTableWidget>
+#include <QTimer>
+
+#include "emulatorcanvas.h"
+
+// live view of how often each opcode handler ran, for builds with
+// CHIP8_STATS
+class StatsDialog : public QDialog
+{
+  Q_OBJECT
+public:
+  StatsDialog(EmulatorCanvas*, QWidget* parent = nullptr);
+
+private slots:
+  void refresh();
+  void clear();
+
+private:
+  EmulatorCanvas* emulator;
+  QTableWidget* table;
+  QLabel* drawTime;
+  QTimer timer;
+};
+
+#endif /* STATSDIALOG_H */
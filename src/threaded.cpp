@@ -0,0 +1,83 @@
+#include "chip8.h"
+
+#ifdef CHIP8_THREADED
+
+#include <algorithm>
+#include <chrono>
+
+// labels as values are a GCC/Clang extension
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+// direct threaded version of emulateCycle(), running the handlers of
+// handlers.inc with pc and I kept in locals across instructions
+unsigned long chip8::runThreaded(unsigned long cycles, std::uint8_t stopOn)
+{
+  // in the order of handlers
+  static const void* const labels[] = {
+    &&CLS,    &&RET,    &&JP_A,   &&CALL,
+    &&SE_VB,  &&SNE_VB, &&SE_VV,  &&LD_VB,
+    &&ADD_VB, &&LD_VV,  &&OR,     &&AND,
+    &&XOR,    &&ADD_VV, &&SUB_VV, &&SHR,
+    &&SUBN,   &&SHL,    &&SNE_VV, &&LD_IA,
+    &&JP_VA,  &&RND,    &&DRW,    &&SKP,
+    &&SKNP,   &&LD_VDT, &&LD_VK,  &&LD_DTV,
+    &&LD_STV, &&ADD_IV, &&LD_FV,  &&LD_BV,
+    &&LD_IV,  &&LD_VI,  &&ILLEGAL
+  };
+
+  if (cycles == 0)
+    return 0;
+
+  std::uint16_t reg_pc = pc;
+  std::uint16_t reg_I  = I;
+  unsigned long done   = 0;
+  Instruction* in;
+
+#ifdef CHIP8_STATS
+#define COUNT() ++stats.executed[in->handler]
+#else
+#define COUNT() do { } while (0)
+#endif
+
+// point in at the instruction under reg_pc and jump to its label,
+// decoding it on first use
+#define FETCH()                                                   \
+  do {                                                            \
+    in = &decoded[reg_pc & 0xFFF];                                \
+    if (in->fn == nullptr)                                        \
+      decode(reg_pc & 0xFFF);                                     \
+    COUNT();                                                      \
+    goto *labels[in->handler];                                    \
+  } while (0)
+
+// end of an instruction, handle the frame and go on to the next
+// instruction unless the run is over
+#define NEXT()                                                    \
+  do {                                                            \
+    if (++frameCycle == cyclesPerFrame)                           \
+      endFrame();                                                 \
+    if (++done == cycles || (events & stopOn))                    \
+      goto out;                                                   \
+    FETCH();                                                      \
+  } while (0)
+
+  FETCH();
+
+// every handler is a label, ending in NEXT()
+#define OPCODE(name, ...) name: __VA_ARGS__ NEXT();
+#define PC reg_pc
+#define REG_I reg_I
+#define OP (*in)
+#include "handlers.inc"
+
+#undef NEXT
+#undef FETCH
+#undef COUNT
+
+out:
+  pc = reg_pc;
+  I  = reg_I;
+  return done;
+}
+
+#endif /* CHIP8_THREADED */
@@ -1,32 +1,96 @@
 #include "timedworker.h"
 
-#include <QElapsedTimer>
+#include <cstring>
+#include <iostream>
 
-TimedWorker::TimedWorker(unsigned int freq) : paused(false)
+#include <pthread.h>
+#include <sched.h>
+
+TimedWorker::TimedWorker(unsigned int freq) :
+  paused(false),
+  running(true),
+  frequency(freq),
+  dropped(0),
+  cpu(-1),
+  realtime(false)
 {
-  setFrequency(freq);
 }
 
 void TimedWorker::run()
 {
-  QElapsedTimer timer;
-  qint64 elapsed;
-  while (true) {
-    // do cpu cycles
-    if (!paused) {
-      timer.start();
+  applySchedulingOptions();
+
+  FrameScheduler scheduler(frequency, frequency / 10 + 1);
+  scheduler.restart(FrameScheduler::now());
+
+  while (running) {
+    // nothing is due while paused, start over from when it resumes
+    if (paused) {
+      FrameScheduler::sleepUntil(FrameScheduler::now() + scheduler.period());
+      scheduler.restart(FrameScheduler::now());
+      continue;
+    }
+
+    if (scheduler.getFrequency() != frequency)
+      scheduler.setFrequency(frequency);
 
-      tick();
-      elapsed = timer.nsecsElapsed() / 1000;
+    std::int64_t now = FrameScheduler::now();
+    std::int64_t deadline = scheduler.next(now);
+    if (deadline > now) {
+      FrameScheduler::sleepUntil(deadline);
+      continue;
     }
 
-    if (elapsed < usecPerFrame)
-      usleep(usecPerFrame - elapsed);
+    // do cpu cycles
+    tick();
+    scheduler.advance();
+    dropped = scheduler.droppedFrames();
   }
 }
 
+// returns once the current tick is done, wait() for the thread to end
+void TimedWorker::stop()
+{
+  running = false;
+}
+
 void TimedWorker::setFrequency(unsigned int freq)
 {
   frequency = freq;
-  usecPerFrame = 1000000 / freq;
+}
+
+void TimedWorker::setAffinity(int cpu)
+{
+  this->cpu = cpu;
+}
+
+void TimedWorker::setRealtime(bool realtime)
+{
+  this->realtime = realtime;
+}
+
+// failing is not fatal, the thread just runs with the defaults
+void TimedWorker::applySchedulingOptions()
+{
+#ifdef __linux__
+  if (cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (error != 0)
+      std::cerr << "Could not pin the emulation thread to cpu " << cpu
+        << ": " << std::strerror(error) << std::endl;
+  }
+#endif
+
+  if (realtime) {
+    // the lowest fifo priority is enough to preempt every normal thread
+    sched_param param;
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (error != 0)
+      std::cerr << "Could not give the emulation thread a real-time "
+        "priority: " << std::strerror(error) << std::endl;
+  }
 }
@@ -1,8 +1,16 @@
 #ifndef TIMEDWORKER_H
 #define TIMEDWORKER_H
 
+#include <atomic>
+#include <cstdint>
+
 #include <QThread>
 
+#include "framescheduler.h"
+
+// calls tick() frequency times per second on its own thread, against
+// absolute deadlines. a thread that fell behind catches up by at most
+// a tenth of a second and drops the rest
 class TimedWorker : public QThread
 {
   Q_OBJECT
@@ -10,16 +18,32 @@ public:
   TimedWorker(unsigned int frequency);
 
   void run();
+  void stop();
   void setFrequency(unsigned int freq);
 
-  bool paused;
+  // pin the thread to a cpu and run it with a real-time priority, both
+  // have to be set before start()
+  void setAffinity(int cpu);
+  void setRealtime(bool);
+
+  std::uint64_t droppedFrames() const { return dropped; }
+
+  std::atomic<bool> paused;
 
 protected:
   virtual void tick() = 0;
 
+  // time between two ticks in nanoseconds
+  std::int64_t framePeriod() const { return 1000000000 / frequency; }
+
 private:
-  unsigned int frequency;
-  unsigned int usecPerFrame;
+  void applySchedulingOptions();
+
+  std::atomic<bool> running;
+  std::atomic<unsigned int> frequency;
+  std::atomic<std::uint64_t> dropped;
+  int cpu;
+  bool realtime;
 };
 
 #endif
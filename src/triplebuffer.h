@@ -0,0 +1,77 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// lock-free handoff of values from one producer thread to one consumer
+// thread. the producer fills back() and publishes it, the consumer picks
+// up the newest published value with update(). neither side ever waits
+template<typename T>
+class TripleBuffer
+{
+public:
+  TripleBuffer() :
+    buffers(),
+    middle(1),
+    backIndex(0),
+    frontIndex(2)
+  {
+  }
+
+  // producer side
+  T& back()
+  {
+    return buffers[backIndex];
+  }
+
+  // make back() the newest value, returns true if the value published
+  // before it was never picked up by the consumer
+  bool publish()
+  {
+    std::uint8_t old = middle.exchange(backIndex | FRESH,
+      std::memory_order_acq_rel);
+    backIndex = old & INDEX;
+    return (old & FRESH) != 0;
+  }
+
+  // true while the value published last has not been picked up. the
+  // consumer may still pick it up right after
+  bool pending() const
+  {
+    return (middle.load(std::memory_order_acquire) & FRESH) != 0;
+  }
+
+  // consumer side, returns true if front() changed to a new value
+  bool update()
+  {
+    if ((middle.load(std::memory_order_relaxed) & FRESH) == 0)
+      return false;
+
+    std::uint8_t old = middle.exchange(frontIndex,
+      std::memory_order_acq_rel);
+    frontIndex = old & INDEX;
+    return true;
+  }
+
+  const T& front() const
+  {
+    return buffers[frontIndex];
+  }
+
+private:
+  static const std::uint8_t INDEX = 0x3;
+  static const std::uint8_t FRESH = 0x4;
+
+  std::array<T, 3> buffers;
+
+  // index of the buffer between the two sides, and whether it is unread
+  std::atomic<std::uint8_t> middle;
+
+  // only touched by the producer and the consumer respectively
+  std::uint8_t backIndex;
+  std::uint8_t frontIndex;
+};
+
+#endif /* TRIPLEBUFFER_H */
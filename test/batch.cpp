@@ -0,0 +1,167 @@
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "batch.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// draws a sprite along a diagonal forever, counting cycles in which key 0
+// is held in V4
+std::shared_ptr<const std::vector<std::uint8_t>> diagonal(std::uint8_t shape)
+{
+  return std::make_shared<const std::vector<std::uint8_t>>(
+    std::vector<std::uint8_t>{
+      0xA2, 0x10,   // LD I, sprite
+      0xD1, 0x25,   // DRW V1, V2, 5
+      0x71, 0x03,   // ADD V1, 3
+      0x72, 0x01,   // ADD V2, 1
+      0xE3, 0x9E,   // SKP V3
+      0x12, 0x02,   // JP 0x202
+      0x74, 0x01,   // ADD V4, 1
+      0x12, 0x02,   // JP 0x202
+      shape, 0x90, 0xF0, 0x90, 0xF0
+    });
+}
+
+std::vector<BatchJob> makeJobs()
+{
+  std::vector<BatchJob> jobs;
+  for (std::uint8_t shape : {0xF0, 0x60, 0x18})
+    for (unsigned long press : {0ul, 50ul, 777ul, 5000ul})
+      for (chip8::Engine engine :
+           {chip8::Engine::Interpreter, chip8::Engine::Jit})
+      {
+        BatchJob job = BatchJob();
+        job.rom = diagonal(shape);
+        job.input = {{press, 0x0001}, {press + 100, 0x0000}};
+        job.frames = 300;
+        job.engine = engine;
+        job.frameHashes = true;
+        jobs.push_back(job);
+      }
+
+  return jobs;
+}
+
+}
+
+TEST(batchTest, same_results_as_sequential_runs)
+{
+  std::vector<BatchJob> jobs = makeJobs();
+
+  std::vector<BatchResult> results(jobs.size());
+  std::set<std::size_t> seen;
+  BatchRunner(4).run(jobs, [&](const BatchResult& result) {
+    ASSERT_TRUE(seen.insert(result.job).second);
+    results[result.job] = result;
+  });
+  ASSERT_EQ(jobs.size(), seen.size());
+
+  for (std::size_t i = 0; i < jobs.size(); i++) {
+    BatchResult expected = BatchRunner::runJob(jobs[i]);
+    EXPECT_TRUE(results[i].loaded);
+    EXPECT_EQ(expected.stateHash, results[i].stateHash);
+    EXPECT_EQ(expected.frameHashes, results[i].frameHashes);
+    EXPECT_EQ(300u, results[i].frames);
+    EXPECT_EQ(300u * 10, results[i].cycles);
+    EXPECT_EQ(300u, results[i].frameHashes.size());
+  }
+}
+
+TEST(batchTest, engines_agree)
+{
+  if (!chip8::engineSupported(chip8::Engine::Jit)) return;
+  std::vector<BatchJob> jobs = makeJobs();
+
+  // jobs come in interpreter / jit pairs
+  for (std::size_t i = 0; i < jobs.size(); i += 2)
+    EXPECT_EQ(BatchRunner::runJob(jobs[i]).stateHash,
+              BatchRunner::runJob(jobs[i + 1]).stateHash);
+}
+
+TEST(batchTest, input_changes_the_result)
+{
+  BatchJob job = BatchJob();
+  job.rom = diagonal(0xF0);
+  job.cycles = 1000;
+
+  BatchResult idle = BatchRunner::runJob(job);
+  job.input = {{500, 0x0001}};
+  BatchResult pressed = BatchRunner::runJob(job);
+
+  EXPECT_EQ(1000u, idle.cycles);
+  EXPECT_EQ(1000u, pressed.cycles);
+  EXPECT_NE(idle.stateHash, pressed.stateHash);
+}
+
+TEST(batchTest, stops_on_illegal_opcode)
+{
+  BatchJob job = BatchJob();
+  job.rom = std::make_shared<const std::vector<std::uint8_t>>(
+    std::vector<std::uint8_t>{0x60, 0x01, 0xFF, 0xFF});
+  job.frames = 100;
+
+  BatchResult result = BatchRunner::runJob(job);
+  EXPECT_TRUE(result.illegalOpcode);
+  EXPECT_EQ(2u, result.cycles);
+  EXPECT_NE(0, result.events & chip8::EVENT_ILLEGAL);
+}
+
+TEST(batchTest, stops_on_event)
+{
+  // V0 += 1, wait for a key
+  BatchJob job = BatchJob();
+  job.rom = std::make_shared<const std::vector<std::uint8_t>>(
+    std::vector<std::uint8_t>{0x70, 0x01, 0xF1, 0x0A});
+  job.stopOn = chip8::EVENT_KEYWAIT;
+
+  BatchResult result = BatchRunner::runJob(job);
+  EXPECT_FALSE(result.illegalOpcode);
+  EXPECT_EQ(2u, result.cycles);
+  EXPECT_NE(0, result.events & chip8::EVENT_KEYWAIT);
+}
+
+TEST(batchTest, rejects_oversized_rom)
+{
+  BatchJob job = BatchJob();
+  job.rom = std::make_shared<const std::vector<std::uint8_t>>(4096);
+  job.frames = 1;
+
+  EXPECT_FALSE(BatchRunner::runJob(job).loaded);
+}
+
+TEST(batchTest, games_are_reproducible)
+{
+  std::vector<BatchJob> jobs;
+  for (const char* game : {"invaders.c8", "pong2.c8", "tetris.c8"}) {
+    std::ifstream file(std::string(GAMES_DIR) + game, std::ios::binary);
+    auto rom = std::make_shared<const std::vector<std::uint8_t>>(
+      (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    for (std::uint64_t seed : {1, 2, 3}) {
+      BatchJob job = BatchJob();
+      job.rom = rom;
+      job.input = {{3000, 0x0010}, {3500, 0x0000}, {9000, 0x0040}};
+      job.frames = 2000;
+      job.seed = seed;
+      jobs.push_back(job);
+    }
+  }
+
+  std::vector<std::uint64_t> hashes(jobs.size());
+  BatchRunner(3).run(jobs, [&](const BatchResult& result) {
+    hashes[result.job] = result.stateHash;
+  });
+
+  for (std::size_t i = 0; i < jobs.size(); i++)
+    EXPECT_EQ(BatchRunner::runJob(jobs[i]).stateHash, hashes[i]);
+
+  // tetris picks its pieces at random
+  EXPECT_NE(hashes[6], hashes[7]);
+}
@@ -0,0 +1,49 @@
+#include <cstdint>
+
+#include "framehandoff.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+chip8::GfxMem screen(std::uint64_t value)
+{
+  chip8::GfxMem gfx;
+  gfx.fill(value);
+  return gfx;
+}
+
+}
+
+TEST(frameHandoffTest, carries_rows_of_dropped_frames)
+{
+  FrameHandoff frames;
+
+  // two frames replaced in a row before the ui picks one up
+  frames.publish(screen(1), 1u << 0);
+  frames.publish(screen(2), 1u << 1);
+  frames.publish(screen(3), 1u << 2);
+
+  ASSERT_TRUE(frames.update());
+  EXPECT_EQ(screen(3), frames.front().gfx);
+  EXPECT_EQ(0x7u, frames.front().dirty);
+
+  // picked up, the next frame only has its own rows
+  frames.publish(screen(4), 1u << 3);
+  ASSERT_TRUE(frames.update());
+  EXPECT_EQ(1u << 3, frames.front().dirty);
+}
+
+TEST(frameHandoffTest, carries_rows_until_picked_up)
+{
+  FrameHandoff frames;
+
+  frames.publish(screen(1), 1u << 0);
+  ASSERT_TRUE(frames.update());
+
+  for (int i = 1; i < 32; i++)
+    frames.publish(screen(i), 1u << i);
+
+  ASSERT_TRUE(frames.update());
+  EXPECT_EQ(~0u & ~1u, frames.front().dirty);
+  EXPECT_FALSE(frames.update());
+}
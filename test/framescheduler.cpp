@@ -0,0 +1,69 @@
+#include <cstdint>
+
+#include "framescheduler.h"
+#include "gtest/gtest.h"
+
+TEST(frameSchedulerTest, deadlines_do_not_drift)
+{
+  FrameScheduler scheduler(60, 4);
+  scheduler.restart(1000);
+
+  // 1/60 s is not a whole number of nanoseconds, a second still is
+  for (int i = 0; i < 60; i++) {
+    std::int64_t deadline = scheduler.next(0);
+    EXPECT_EQ(1000 + i * 1000000000ll / 60, deadline);
+    scheduler.advance();
+  }
+  EXPECT_EQ(1000 + 1000000000ll, scheduler.next(0));
+  EXPECT_EQ(0u, scheduler.droppedFrames());
+}
+
+TEST(frameSchedulerTest, catches_up_within_bounds)
+{
+  FrameScheduler scheduler(100, 4);
+  scheduler.restart(0);
+
+  // three frames late, all of them are run right away
+  std::int64_t now = 25000000;
+  int run = 0;
+  while (scheduler.next(now) <= now) {
+    scheduler.advance();
+    ++run;
+  }
+  EXPECT_EQ(3, run);
+  EXPECT_EQ(30000000, scheduler.next(now));
+  EXPECT_EQ(0u, scheduler.droppedFrames());
+
+  // a second late, only the last four frames are run
+  now = 1025000000;
+  run = 0;
+  while (scheduler.next(now) <= now) {
+    scheduler.advance();
+    ++run;
+  }
+  EXPECT_EQ(4, run);
+  EXPECT_EQ(96u, scheduler.droppedFrames());
+  EXPECT_EQ(1030000000, scheduler.next(now));
+}
+
+TEST(frameSchedulerTest, frequency_change)
+{
+  FrameScheduler scheduler(50, 4);
+  scheduler.restart(0);
+  scheduler.advance();
+  scheduler.advance();
+
+  // the pending frame stays where it was, the ones after it move
+  scheduler.setFrequency(100);
+  EXPECT_EQ(40000000, scheduler.next(0));
+  scheduler.advance();
+  EXPECT_EQ(50000000, scheduler.next(0));
+  EXPECT_EQ(10000000, scheduler.period());
+}
+
+TEST(frameSchedulerTest, sleeps_until_deadline)
+{
+  std::int64_t deadline = FrameScheduler::now() + 2000000;
+  FrameScheduler::sleepUntil(deadline);
+  EXPECT_GE(FrameScheduler::now(), deadline);
+}
@@ -0,0 +1,213 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "chip8.h"
+#include "jit.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+class Machine : public chip8
+{
+public:
+  void load(const std::vector<std::uint8_t>& program)
+  {
+    std::copy(program.begin(), program.end(), memory.begin() + 512);
+  }
+
+  std::uint8_t reg(int i) const { return V[i]; }
+
+  void pressOnly(int k)
+  {
+    std::array<std::uint8_t, 16> keys{{}};
+    if (k >= 0)
+      keys[k] = 1;
+    setKeys(keys);
+  }
+
+  void expectSameState(const Machine& ref) const
+  {
+    EXPECT_EQ(ref.I, I);
+    EXPECT_EQ(ref.pc, pc);
+    EXPECT_EQ(ref.sp, sp);
+    EXPECT_EQ(ref.delay_timer, delay_timer);
+    EXPECT_EQ(ref.sound_timer, sound_timer);
+    EXPECT_EQ(ref.beep, beep);
+    EXPECT_EQ(ref.stack, stack);
+    EXPECT_EQ(ref.V, V);
+    EXPECT_EQ(ref.memory, memory);
+    EXPECT_EQ(ref.gfx, gfx);
+    EXPECT_EQ(ref.rng, rng);
+  }
+};
+
+// runs a game with scripted input, in chunks so that blocks get cut short
+void runGame(Machine& emu, const std::string& game)
+{
+  ASSERT_TRUE(emu.loadGame(std::string(GAMES_DIR) + game));
+
+  for (int chunk = 0; chunk < 2000; ++chunk) {
+    emu.pressOnly(chunk % 7 == 0 ? (chunk / 7) % 16 : -1);
+    chip8::RunResult result =
+      emu.runCycles(97 + chunk % 5, chip8::EVENT_NONE);
+    ASSERT_EQ(97u + chunk % 5, result.cycles);
+  }
+}
+
+}
+
+class jitTest : public ::testing::TestWithParam<const char*>
+{
+protected:
+  void SetUp() override
+  {
+    supported = jit.setEngine(chip8::Engine::Jit);
+  }
+
+  bool supported;
+  Machine interpreter;
+  Machine jit;
+};
+
+TEST_P(jitTest, matches_interpreter)
+{
+  if (!supported) return;
+
+  runGame(interpreter, GetParam());
+  runGame(jit, GetParam());
+
+  ASSERT_EQ(chip8::Engine::Jit, jit.getEngine());
+  jit.expectSameState(interpreter);
+}
+
+INSTANTIATE_TEST_CASE_P(games, jitTest,
+  ::testing::Values("pong2.c8", "tetris.c8", "invaders.c8"));
+
+TEST_F(jitTest, self_modifying_code)
+{
+  std::vector<std::uint8_t> program{{
+    0x6A, 0x01, // 0x200 VA = 0x01
+    0x7A, 0x01, // 0x202 VA += 1
+    0x12, 0x08, // 0x204 jump to 0x208
+    0x00, 0x00,
+    0x60, 0x6A, // 0x208 V0 = 0x6A
+    0x61, 0x10, // 0x20A V1 = 0x10
+    0xA2, 0x00, // 0x20C I = 0x200
+    0xF1, 0x55, // 0x20E overwrite 0x200 with VA = 0x10
+    0x12, 0x00  // 0x210 jump to 0x200
+  }};
+  if (!supported) return;
+
+  interpreter.load(program);
+  jit.load(program);
+
+  interpreter.runCycles(10, chip8::EVENT_NONE);
+  jit.runCycles(10, chip8::EVENT_NONE);
+
+  ASSERT_EQ(0x11, jit.reg(0xA));
+  jit.expectSameState(interpreter);
+}
+
+// blocks longer than a frame used to never fit, which left everything to
+// the interpreter at the default clock rate
+TEST_F(jitTest, long_blocks_run_compiled)
+{
+  std::vector<std::uint8_t> program;
+  for (int i = 0; i < 40; ++i) {
+    program.push_back(0x70);  // V0 += 1
+    program.push_back(0x01);
+  }
+  program.push_back(0x12);    // jump to 0x200
+  program.push_back(0x00);
+  if (!supported) return;
+
+  interpreter.load(program);
+  jit.load(program);
+
+  Jit native(jit);
+  for (int frame = 0; frame < 100; ++frame) {
+    interpreter.runUntilFrame(chip8::EVENT_NONE);
+    native.run(interpreter.getCyclesPerFrame(), chip8::EVENT_NONE);
+  }
+
+  // the jumps are compiled into the blocks as well
+  EXPECT_EQ(1000u, native.compiledCycles());
+  jit.expectSameState(interpreter);
+}
+
+// jumps, calls, returns and skips end their block natively, the illegal
+// opcodes are never reached
+TEST_F(jitTest, branches_run_compiled)
+{
+  std::vector<std::uint8_t> program{{
+    0x60, 0x05, // 0x200 V0 = 5
+    0x30, 0x05, // 0x202 skip if V0 == 5
+    0x00, 0x00,
+    0x40, 0x05, // 0x206 skip if V0 != 5
+    0x50, 0x10, // 0x208 skip if V0 == V1
+    0x90, 0x10, // 0x20A skip if V0 != V1
+    0x00, 0x00,
+    0xE0, 0x9E, // 0x20E skip if key V0 is pressed
+    0x00, 0x00,
+    0xE1, 0xA1, // 0x212 skip if key V1 is not pressed
+    0x00, 0x00,
+    0x22, 0x20, // 0x216 call 0x220
+    0xB2, 0x15, // 0x218 jump to 0x215 + V0
+    0x12, 0x00, // 0x21A jump to 0x200
+    0x00, 0x00,
+    0x00, 0x00,
+    0x71, 0x02, // 0x220 V1 += 2
+    0x00, 0xEE  // 0x222 return
+  }};
+  if (!supported) return;
+
+  interpreter.load(program);
+  jit.load(program);
+  interpreter.pressOnly(5);
+  jit.pressOnly(5);
+
+  Jit native(jit);
+  for (int frame = 0; frame < 100; ++frame) {
+    interpreter.runUntilFrame(chip8::EVENT_NONE);
+    native.run(interpreter.getCyclesPerFrame(), chip8::EVENT_NONE);
+  }
+
+  EXPECT_FALSE(jit.illegalOpcode);
+  EXPECT_EQ(1000u, native.compiledCycles());
+  jit.expectSameState(interpreter);
+}
+
+// draws, stores and waits are run by the interpreter from inside the
+// blocks, which still stop right after an event to stop on
+TEST_F(jitTest, interpreted_instructions_run_in_blocks)
+{
+  std::vector<std::uint8_t> program{{
+    0xA3, 0x00, // 0x200 I = 0x300
+    0xC0, 0xFF, // 0x202 V0 = random
+    0xF0, 0x33, // 0x204 store BCD of V0 at 0x300
+    0xD0, 0x15, // 0x206 draw
+    0xF1, 0x18, // 0x208 sound timer = V1
+    0x71, 0x01, // 0x20A V1 += 1
+    0x12, 0x00  // 0x20C jump to 0x200
+  }};
+  if (!supported) return;
+
+  interpreter.load(program);
+  jit.load(program);
+
+  Jit native(jit);
+  for (int frame = 0; frame < 100; ++frame) {
+    interpreter.runUntilFrame(chip8::EVENT_NONE);
+    native.run(interpreter.getCyclesPerFrame(), chip8::EVENT_NONE);
+  }
+
+  EXPECT_EQ(1000u, native.compiledCycles());
+  jit.expectSameState(interpreter);
+
+  chip8::RunResult a = interpreter.runCycles(100, chip8::EVENT_DRAW);
+  chip8::RunResult b = jit.runCycles(100, chip8::EVENT_DRAW);
+  EXPECT_EQ(a.cycles, b.cycles);
+  EXPECT_EQ(a.events, b.events);
+  jit.expectSameState(interpreter);
+}
@@ -0,0 +1,295 @@
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "chip8.h"
+#include "lockstep.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+std::array<std::uint8_t, 16> keyArray(std::uint16_t keys)
+{
+  std::array<std::uint8_t, 16> array;
+  for (int i = 0; i < 16; i++)
+    array[i] = (keys >> i) & 1;
+  return array;
+}
+
+// runs the rom on every lane and on one interpreter per lane, with lane l
+// holding keys(l, chunk) during each chunk of cycles
+template<unsigned int N, typename Keys>
+void expectSameAsInterpreter(const std::vector<std::uint8_t>& rom,
+  Keys keys, int chunks, unsigned long cycles,
+  chip8::Engine engine = chip8::Engine::Interpreter)
+{
+  // every lane with its own seed
+  std::unique_ptr<Lockstep<N>> lanes(new Lockstep<N>());
+  for (unsigned int l = 0; l < N; l++)
+    lanes->seed(l, l * 7919);
+  ASSERT_TRUE(lanes->loadGame(rom.data(), rom.size()));
+
+  std::vector<std::unique_ptr<chip8>> reference;
+  for (unsigned int l = 0; l < N; l++) {
+    reference.emplace_back(new chip8());
+    reference[l]->seed(l * 7919);
+    ASSERT_TRUE(reference[l]->setEngine(engine));
+    ASSERT_TRUE(reference[l]->loadGame(rom.data(), rom.size()));
+  }
+
+  for (int chunk = 0; chunk < chunks; chunk++) {
+    for (unsigned int l = 0; l < N; l++) {
+      lanes->setKeys(l, keys(l, chunk));
+      reference[l]->setKeys(keyArray(keys(l, chunk)));
+      reference[l]->runCycles(cycles, chip8::EVENT_NONE);
+    }
+    lanes->runCycles(cycles);
+
+    for (unsigned int l = 0; l < N; l++) {
+      ASSERT_EQ(reference[l]->stateHash(), lanes->stateHash(l))
+        << "lane " << l << ", chunk " << chunk;
+      ASSERT_EQ(reference[l]->beep, lanes->beep(l));
+      ASSERT_EQ(reference[l]->illegalOpcode, lanes->illegalOpcode(l));
+    }
+  }
+}
+
+// straight-line programs of random instructions looping back to the
+// start. memory is only written in the data area, and VE holds the key
+// checked by the skips so that lanes with different keys diverge
+std::vector<std::uint8_t> randomProgram(std::mt19937& rng, int length)
+{
+  auto r = [&](int n) { return static_cast<std::uint16_t>(rng() % n); };
+
+  std::vector<std::uint16_t> program;
+  program.push_back(0x6E00 | r(16));
+  while (static_cast<int>(program.size()) < length) {
+    std::uint16_t x = r(0xE);
+    std::uint16_t y = r(0xF);
+    std::uint16_t nn = r(0x100);
+    switch (r(17)) {
+    case 0:  program.push_back(0x6000 | x << 8 | nn); break;
+    case 1:  program.push_back(0x7000 | x << 8 | nn); break;
+    case 2: {
+      static const std::uint16_t alu[] = {0, 1, 2, 3, 4, 5, 6, 7, 0xE};
+      program.push_back(0x8000 | x << 8 | y << 4 | alu[r(9)]);
+      break;
+    }
+    case 3:  program.push_back(0x3000 | x << 8 | nn); break;
+    case 4:  program.push_back(0x4000 | x << 8 | nn); break;
+    case 5:  program.push_back(0x5000 | x << 8 | y << 4); break;
+    case 6:  program.push_back(0x9000 | x << 8 | y << 4); break;
+    case 7:  program.push_back(0xA600 | r(0x100)); break;
+    case 8:  program.push_back(0xD000 | x << 8 | y << 4 | r(16)); break;
+    case 9:  program.push_back(0xEE9E); break;
+    case 10: program.push_back(0xEEA1); break;
+    case 11: program.push_back(0xF007 | x << 8); break;
+    case 12: program.push_back(0xF015 | x << 8); break;
+    case 13: program.push_back(0xF018 | x << 8); break;
+    case 14: program.push_back(0xF029 | x << 8); break;
+    case 16: program.push_back(0xC000 | x << 8 | nn); break;
+    case 15: {
+      // writes go to the data area, the no-op keeps a skip from jumping
+      // over the LD I in front of them
+      static const std::uint16_t mem[] = {0x33, 0x55, 0x65, 0x0A};
+      std::uint16_t op = mem[r(4)];
+      if (op == 0x33 || op == 0x55) {
+        program.push_back(0x7D00);
+        program.push_back(0xA600 | r(0x100));
+      }
+      program.push_back(0xF000 | x << 8 | op);
+      break;
+    }
+    }
+  }
+
+  // twice, in case the last instruction skips
+  program.push_back(0x1200);
+  program.push_back(0x1200);
+
+  std::vector<std::uint8_t> bytes;
+  for (std::uint16_t opcode : program) {
+    bytes.push_back(opcode >> 8);
+    bytes.push_back(opcode & 0xFF);
+  }
+  return bytes;
+}
+
+// programs of random instructions of every kind, looping back to the
+// start. calls go 17 deep before anything else runs and return into the
+// middle of the program, I runs past the end of memory, and keys are
+// picked by any value. the jumps land on instructions of the program and
+// memory is only written outside of it
+std::vector<std::uint8_t> randomOpcodes(std::mt19937& rng, int length)
+{
+  auto r = [&](int n) { return static_cast<std::uint16_t>(rng() % n); };
+
+  const int depth = 17;
+  std::vector<std::uint16_t> program;
+  for (int i = 0; i < depth; i++)
+    program.push_back(0x2000 | (0x202 + 2 * i));
+
+  // an instruction of the part after the calls
+  auto target = [&]() {
+    return static_cast<std::uint16_t>(0x200 + 2 * (depth + r(length)));
+  };
+
+  while (static_cast<int>(program.size()) < depth + length) {
+    std::uint16_t x = r(0x10);
+    std::uint16_t y = r(0x10);
+    std::uint16_t nn = r(0x100);
+    switch (r(20)) {
+    case 0:  program.push_back(r(2) ? 0x00E0 : 0x00EE); break;
+    case 1:  program.push_back(0x1000 | target()); break;
+    case 2:  program.push_back(0x2000 | target()); break;
+    case 3:  program.push_back(0x3000 | x << 8 | nn); break;
+    case 4:  program.push_back(0x4000 | x << 8 | nn); break;
+    case 5:  program.push_back(0x5000 | x << 8 | y << 4); break;
+    case 6:  program.push_back(0x6000 | x << 8 | nn); break;
+    case 7:  program.push_back(0x7000 | x << 8 | nn); break;
+    case 8: {
+      static const std::uint16_t alu[] = {0, 1, 2, 3, 4, 5, 6, 7, 0xE};
+      program.push_back(0x8000 | x << 8 | y << 4 | alu[r(9)]);
+      break;
+    }
+    case 9:  program.push_back(0x9000 | x << 8 | y << 4); break;
+    case 10: program.push_back(0xA000 | r(0x1000)); break;
+    case 11:
+      // the no-op keeps a skip from jumping over the LD V0
+      program.push_back(0x7D00);
+      program.push_back(0x6000 | 2 * r(0x80));
+      program.push_back(0xB000 | (0x200 + 2 * depth));
+      break;
+    case 12: program.push_back(0xC000 | x << 8 | nn); break;
+    case 13: program.push_back(0xD000 | x << 8 | y << 4 | r(16)); break;
+    case 14: program.push_back(0xE09E | x << 8); break;
+    case 15: program.push_back(0xE0A1 | x << 8); break;
+    case 16: {
+      static const std::uint16_t timers[] = {0x07, 0x0A, 0x15, 0x18, 0x29};
+      program.push_back(0xF000 | x << 8 | timers[r(5)]);
+      break;
+    }
+    case 17: program.push_back(0xF01E | x << 8); break;
+    case 18: program.push_back(0xF065 | x << 8); break;
+    case 19:
+      // writes start in the last page and wrap into the font
+      program.push_back(0x7D00);
+      program.push_back(0xAF00 | r(0x100));
+      program.push_back(0xF000 | x << 8 | (r(2) ? 0x33 : 0x55));
+      break;
+    }
+  }
+
+  program.push_back(0x1200);
+  program.push_back(0x1200);
+
+  std::vector<std::uint8_t> bytes;
+  for (std::uint16_t opcode : program) {
+    bytes.push_back(opcode >> 8);
+    bytes.push_back(opcode & 0xFF);
+  }
+  return bytes;
+}
+
+}
+
+TEST(lockstepTest, random_programs)
+{
+  std::mt19937 rng(42);
+  for (int i = 0; i < 20; i++) {
+    std::vector<std::uint8_t> rom = randomProgram(rng, 200);
+    expectSameAsInterpreter<8>(rom,
+      [](unsigned int l, int chunk) {
+        return static_cast<std::uint16_t>(l * 0x1F3 + chunk * 0x71);
+      }, 20, 97);
+  }
+}
+
+TEST(lockstepTest, random_opcodes)
+{
+  for (chip8::Engine engine :
+       {chip8::Engine::Interpreter, chip8::Engine::Jit})
+  {
+    if (!chip8::engineSupported(engine))
+      continue;
+
+    std::mt19937 rng(1234);
+    for (int i = 0; i < 40; i++) {
+      std::vector<std::uint8_t> rom = randomOpcodes(rng, 200);
+      expectSameAsInterpreter<8>(rom,
+        [](unsigned int l, int chunk) {
+          return static_cast<std::uint16_t>(
+            chunk % 4 == 0 ? 0 : l * 0x2B5 + chunk * 0x1C3);
+        }, 20, 151, engine);
+    }
+  }
+}
+
+TEST(lockstepTest, lane_counts)
+{
+  std::mt19937 rng(7);
+  std::vector<std::uint8_t> rom = randomProgram(rng, 300);
+  auto keys = [](unsigned int l, int chunk) {
+    return static_cast<std::uint16_t>(
+      chunk % 3 == 0 ? 1 << ((l + chunk) % 16) : 0);
+  };
+
+  expectSameAsInterpreter<8>(rom, keys, 30, 133);
+  expectSameAsInterpreter<16>(rom, keys, 30, 133);
+  expectSameAsInterpreter<32>(rom, keys, 30, 133);
+}
+
+TEST(lockstepTest, calls_and_self_modifying_code)
+{
+  std::vector<std::uint8_t> rom{
+    0x22, 0x0A,   // CALL 0x20A
+    0xEE, 0x9E,   // SKP VE
+    0x12, 0x00,   // JP 0x200
+    0x72, 0x01,   // ADD V2, 1
+    0x12, 0x00,   // JP 0x200
+    // 0x20A: rewrite the operand of the ADD above with V0, then return
+    0x70, 0x01,   // ADD V0, 1
+    0xA2, 0x07,   // LD I, 0x207
+    0xF0, 0x55,   // LD [I], V0
+    0x00, 0xEE,   // RET
+  };
+
+  expectSameAsInterpreter<16>(rom,
+    [](unsigned int l, int chunk) {
+      return static_cast<std::uint16_t>((l + chunk) % 4 == 0 ? 0xFFFF : 0);
+    }, 40, 31);
+}
+
+TEST(lockstepTest, illegal_opcode)
+{
+  // lanes holding key 0 run into an illegal opcode
+  std::vector<std::uint8_t> rom{
+    0xE0, 0xA1,   // SKNP V0
+    0xFF, 0xFF,
+    0x12, 0x00,   // JP 0x200
+  };
+
+  expectSameAsInterpreter<8>(rom,
+    [](unsigned int l, int) { return static_cast<std::uint16_t>(l % 2); },
+    5, 50);
+}
+
+TEST(lockstepTest, games)
+{
+  for (const char* game : {"invaders.c8", "pong2.c8", "tetris.c8"}) {
+    std::ifstream file(std::string(GAMES_DIR) + game, std::ios::binary);
+    std::vector<std::uint8_t> rom((std::istreambuf_iterator<char>(file)),
+      std::istreambuf_iterator<char>());
+    ASSERT_FALSE(rom.empty());
+
+    expectSameAsInterpreter<8>(rom,
+      [](unsigned int l, int chunk) {
+        return static_cast<std::uint16_t>(
+          chunk % 5 < 2 ? 1 << (l * 3 % 16) : 0);
+      }, 200, 101);
+  }
+}
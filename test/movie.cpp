@@ -0,0 +1,174 @@
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "movie.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+std::vector<std::uint8_t> readRom(const std::string& game)
+{
+  std::ifstream file(std::string(GAMES_DIR) + game, std::ios::binary);
+  return std::vector<std::uint8_t>((std::istreambuf_iterator<char>(file)),
+    std::istreambuf_iterator<char>());
+}
+
+// plays a game with changing input for a while, recording it
+std::uint64_t recordSession(const std::vector<std::uint8_t>& rom,
+  Movie& movie, chip8::Engine engine)
+{
+  chip8 emu;
+  emu.setEngine(engine);
+  emu.seed(77);
+  EXPECT_TRUE(emu.loadGame(rom.data(), rom.size()));
+  movie.start(rom.data(), rom.size(), 77, emu.getCyclesPerFrame());
+
+  std::uint64_t cycle = 0;
+  for (int step = 0; step < 3000; step++) {
+    std::uint16_t keys = step % 40 < 15 ? 1 << (step / 40 % 16) : 0;
+    std::array<std::uint8_t, 16> array;
+    for (int i = 0; i < 16; i++)
+      array[i] = (keys >> i) & 1;
+    emu.setKeys(array);
+    movie.record(cycle, keys);
+
+    cycle += emu.runCycles(7 + step % 13, chip8::EVENT_NONE).cycles;
+  }
+  movie.finish(cycle);
+
+  return emu.stateHash();
+}
+
+}
+
+TEST(movieTest, replays_a_session)
+{
+  std::vector<std::uint8_t> rom = readRom("tetris.c8");
+
+  for (chip8::Engine engine :
+       {chip8::Engine::Interpreter, chip8::Engine::Jit})
+  {
+    Movie movie;
+    std::uint64_t expected = recordSession(rom, movie, engine);
+
+    const std::string filename = "movie_test.c8m";
+    ASSERT_TRUE(movie.save(filename));
+    Movie loaded;
+    ASSERT_TRUE(loaded.load(filename));
+    std::remove(filename.c_str());
+
+    ASSERT_EQ(movie.length, loaded.length);
+    ASSERT_EQ(movie.input.size(), loaded.input.size());
+
+    chip8 emu;
+    MoviePlayer player(loaded);
+    ASSERT_TRUE(player.begin(emu, rom.data(), rom.size()));
+    chip8::RunResult result = player.run(emu);
+
+    EXPECT_TRUE(player.finished());
+    EXPECT_EQ(loaded.length, result.cycles);
+    EXPECT_EQ(expected, emu.stateHash());
+  }
+}
+
+TEST(movieTest, frame_by_frame)
+{
+  std::vector<std::uint8_t> rom = readRom("invaders.c8");
+  Movie movie;
+  std::uint64_t expected =
+    recordSession(rom, movie, chip8::Engine::Interpreter);
+
+  // stopping at every frame does not change the outcome
+  chip8 emu;
+  MoviePlayer player(movie);
+  ASSERT_TRUE(player.begin(emu, rom.data(), rom.size()));
+
+  unsigned long frames = 0;
+  while (!player.finished()) {
+    player.run(emu, chip8::EVENT_FRAME);
+    ++frames;
+  }
+
+  EXPECT_EQ(expected, emu.stateHash());
+  EXPECT_GE(frames, movie.length / emu.getCyclesPerFrame());
+}
+
+// the worker splits played frames where the sound starts or stops, so the
+// tone changes on the right sample
+TEST(movieTest, stops_where_the_sound_changes)
+{
+  std::vector<std::uint8_t> rom = readRom("pong2.c8");
+  Movie movie;
+  std::uint64_t expected =
+    recordSession(rom, movie, chip8::Engine::Interpreter);
+
+  chip8 emu;
+  MoviePlayer player(movie);
+  ASSERT_TRUE(player.begin(emu, rom.data(), rom.size()));
+
+  unsigned long changes = 0;
+  while (!player.finished()) {
+    bool on = emu.getSoundTimer() > 0;
+    chip8::RunResult result =
+      player.run(emu, chip8::EVENT_FRAME | chip8::EVENT_SOUND);
+    if (result.events & chip8::EVENT_SOUND) {
+      EXPECT_NE(on, emu.getSoundTimer() > 0);
+      ++changes;
+    }
+  }
+
+  EXPECT_GT(changes, 0u);
+  EXPECT_EQ(expected, emu.stateHash());
+}
+
+TEST(movieTest, only_changes_are_stored)
+{
+  Movie movie;
+  movie.record(0, 0x0000);
+  movie.record(10, 0x0001);
+  movie.record(20, 0x0001);
+  movie.record(30, 0x0003);
+  movie.record(30, 0x0001);
+  movie.record(40, 0x0000);
+  movie.record(40, 0x0004);
+
+  ASSERT_EQ(2u, movie.input.size());
+  EXPECT_EQ(10u, movie.input[0].cycle);
+  EXPECT_EQ(0x0001, movie.input[0].keys);
+  EXPECT_EQ(40u, movie.input[1].cycle);
+  EXPECT_EQ(0x0004, movie.input[1].keys);
+}
+
+TEST(movieTest, compact)
+{
+  std::vector<std::uint8_t> rom = readRom("pong2.c8");
+  Movie movie;
+  recordSession(rom, movie, chip8::Engine::Interpreter);
+
+  const std::string filename = "movie_test.c8m";
+  ASSERT_TRUE(movie.save(filename));
+  std::ifstream file(filename, std::ios::binary | std::ios::ate);
+  std::streamoff size = file.tellg();
+  std::remove(filename.c_str());
+
+  // a header plus a few bytes per key change
+  EXPECT_LE(size, static_cast<std::streamoff>(46 + movie.input.size() * 4));
+}
+
+TEST(movieTest, rejects_other_rom)
+{
+  std::vector<std::uint8_t> rom = readRom("pong2.c8");
+  std::vector<std::uint8_t> other = readRom("tetris.c8");
+
+  Movie movie;
+  recordSession(rom, movie, chip8::Engine::Interpreter);
+
+  chip8 emu;
+  MoviePlayer player(movie);
+  EXPECT_FALSE(player.begin(emu, other.data(), other.size()));
+  EXPECT_TRUE(player.begin(emu, rom.data(), rom.size()));
+}
@@ -14,7 +14,7 @@ TEST_F(chip8Test, op_0x00E0)
   memory[512 + 1] = 0xE0;
 
   // fill video buffer with 1
-  std::fill(gfx.begin(), gfx.end(), 1);
+  std::fill(gfx.begin(), gfx.end(), ~0ULL);
 
   // clear the screen
   emulateCycle();
@@ -24,7 +24,7 @@ TEST_F(chip8Test, op_0x00E0)
 
   // check and see if gfx is cleared
   std::array<std::uint8_t, 2048> temp{{0}};
-  ASSERT_EQ(temp, gfx);
+  ASSERT_EQ(temp, toBytes(gfx));
 }
 
 TEST_F(chip8Test, op_0x00EE)
@@ -538,18 +538,112 @@ TEST_F(chip8Test, op_BNNN)
   ASSERT_EQ((0xA30 + 0xCC), pc);
 }
 
+TEST_F(chip8Test, op_BNNN_past_end)
+{
+  // V0 = 0xFF, jump to 0xFFF + V0
+  memory[512]     = 0x60;
+  memory[512 + 1] = 0xFF;
+  memory[514]     = 0xBF;
+  memory[514 + 1] = 0xFF;
+
+  // V1 = 0x42 where the jump lands once wrapped
+  memory[0x0FE]     = 0x61;
+  memory[0x0FE + 1] = 0x42;
+
+  emulateCycle();
+  emulateCycle();
+  ASSERT_EQ(0x10FE, pc);
+
+  // the fetch wraps around the end of memory
+  emulateCycle();
+  ASSERT_EQ(0x42, V[1]);
+  ASSERT_EQ(0x1100, pc);
+}
+
+TEST_F(chip8Test, op_skip_at_end)
+{
+  // V0 == 0, so the skip at the last instruction of memory is taken
+  memory[0xFFE]     = 0x30;
+  memory[0xFFE + 1] = 0x00;
+  pc = 0xFFE;
+
+  // V3 = 0x09 at the instruction after the skipped one, wrapped
+  memory[0x002]     = 0x63;
+  memory[0x002 + 1] = 0x09;
+
+  emulateCycle();
+  ASSERT_EQ(0x1002, pc);
+
+  emulateCycle();
+  ASSERT_EQ(0x09, V[3]);
+}
+
 TEST_F(chip8Test, op_CXNN)
 {
-  // rng assumes std::rand
   memory[512]     = 0xCA;
   memory[512 + 1] = 0x30;
 
   // make sure rng is in known state
-  std::srand(13);
+  seed(13);
+  std::uint64_t state = rng;
   emulateCycle();
 
-  std::srand(13);
-  ASSERT_EQ(std::rand() & 0x30, V[0xA]);
+  ASSERT_EQ(random(state) & 0x30, V[0xA]);
+  ASSERT_EQ(state, rng);
+}
+
+TEST_F(chip8Test, op_CXNN_full_range)
+{
+  // 0xCAFF over and over
+  memory[512]     = 0xCA;
+  memory[512 + 1] = 0xFF;
+  memory[514]     = 0x12;
+  memory[514 + 1] = 0x00;
+
+  std::array<int, 256> seen{{}};
+  for (int i = 0; i < 8192; i++) {
+    runCycles(2, EVENT_NONE);
+    seen[V[0xA]]++;
+  }
+
+  // every value comes up, 255 included
+  for (int value = 0; value < 256; value++)
+    EXPECT_LT(0, seen[value]) << value;
+}
+
+TEST_F(chip8Test, seed_reproducible)
+{
+  memory[512]     = 0xC0;
+  memory[512 + 1] = 0xFF;
+  memory[514]     = 0x12;
+  memory[514 + 1] = 0x00;
+
+  seed(99);
+  std::vector<std::uint8_t> first;
+  for (int i = 0; i < 64; i++) {
+    runCycles(2, EVENT_NONE);
+    first.push_back(V[0x0]);
+  }
+
+  // a reset starts over from the same seed
+  reset();
+  memory[512]     = 0xC0;
+  memory[512 + 1] = 0xFF;
+  memory[514]     = 0x12;
+  memory[514 + 1] = 0x00;
+  for (int i = 0; i < 64; i++) {
+    runCycles(2, EVENT_NONE);
+    ASSERT_EQ(first[i], V[0x0]);
+  }
+
+  // another seed gives other numbers
+  seed(100);
+  int same = 0;
+  for (int i = 0; i < 64; i++) {
+    runCycles(2, EVENT_NONE);
+    same += first[i] == V[0x0];
+  }
+  EXPECT_GT(8, same);
 }
 
 TEST_F(chip8Test, op_0xDXYN)
@@ -584,12 +678,46 @@ TEST_F(chip8Test, op_0xDXYN)
   expected[7 + 10*64] = 1;
   expected[7 + 11*64] = 1;
 
-  ASSERT_EQ(expected, gfx);
+  ASSERT_EQ(expected, toBytes(gfx));
+
+  // nothing was erased
+  ASSERT_EQ(0, V[0xF]);
 
   // check that pc was incremented
   ASSERT_EQ(514, pc);
 }
 
+TEST_F(chip8Test, op_0xDXYN_wrap)
+{
+  // set op code
+  memory[512]     = 0xD6;
+  memory[512 + 1] = 0x72;
+
+  // two full rows in the bottom right corner
+  I = 0xA30;
+  memory[0xA30]     = 0xFF;
+  memory[0xA30 + 1] = 0xFF;
+  V[0x6] = 60;
+  V[0x7] = 31;
+
+  // one pixel that is already set
+  gfx[31] = 1ULL << (63 - 61);
+
+  emulateCycle();
+
+  // the sprite wraps around both edges
+  std::array<std::uint8_t, 2048> expected{{0}};
+  for (int x : {60, 62, 63, 0, 1, 2, 3})
+    expected[x + 31*64] = 1;
+  for (int x : {60, 61, 62, 63, 0, 1, 2, 3})
+    expected[x + 0*64] = 1;
+
+  ASSERT_EQ(expected, toBytes(gfx));
+
+  // a set pixel was erased
+  ASSERT_EQ(1, V[0xF]);
+}
+
 TEST_F(chip8Test, op_EX9E)
 {
   // set op code
@@ -709,8 +837,8 @@ TEST_F(chip8Test, op_FX15)
   // set delay_timer to VX
   emulateCycle();
 
-  // check delay_timer = VX (timers -= 1 at end of cycle)
-  ASSERT_EQ(0x55 - 1, delay_timer);
+  // check delay_timer = VX (timers -= 1 at end of frame)
+  ASSERT_EQ(0x55, delay_timer);
 
   // check incremented
   ASSERT_EQ(514, pc);
@@ -728,8 +856,8 @@ TEST_F(chip8Test, op_FX18)
   // set sound_timer to VX
   emulateCycle();
 
-  // check sound_timer = VX (timers -= 1 at end of cycle)
-  ASSERT_EQ(0x55 - 1, sound_timer);
+  // check sound_timer = VX (timers -= 1 at end of frame)
+  ASSERT_EQ(0x55, sound_timer);
 
   // check incremented
   ASSERT_EQ(514, pc);
@@ -823,3 +951,116 @@ TEST_F(chip8Test, op_FX65)
   // check incremented
   ASSERT_EQ(514, pc);
 }
+
+TEST_F(chip8Test, op_illegal)
+{
+  // set op code, 0xFX00 is not a valid instruction
+  memory[512]     = 0xF3;
+  memory[512 + 1] = 0x00;
+
+  emulateCycle();
+
+  // check that the opcode was flagged
+  ASSERT_TRUE(illegalOpcode);
+
+  // check that pc was not incremented
+  ASSERT_EQ(512, pc);
+}
+
+TEST_F(chip8Test, op_FX55_self_modifying)
+{
+  // VA = 0x11 at 0x202, executed once so it is decoded
+  memory[0x202]     = 0x6A;
+  memory[0x202 + 1] = 0x11;
+  pc = 0x202;
+  emulateCycle();
+  ASSERT_EQ(0x11, V[0xA]);
+
+  // overwrite it with VA = 0x22 from 0x200
+  memory[0x200]     = 0xF1;
+  memory[0x200 + 1] = 0x55;
+  V[0x0] = 0x6A;
+  V[0x1] = 0x22;
+  I = 0x202;
+  pc = 0x200;
+  emulateCycle();
+
+  // the modified instruction has to be executed, not the cached one
+  emulateCycle();
+  ASSERT_EQ(0x22, V[0xA]);
+}
+
+TEST_F(chip8Test, op_FX33_self_modifying)
+{
+  // VA = 0x11 at 0x203, executed once so it is decoded
+  memory[0x203]     = 0x6A;
+  memory[0x203 + 1] = 0x11;
+  pc = 0x203;
+  emulateCycle();
+  ASSERT_EQ(0x11, V[0xA]);
+
+  // write the BCD of 123 over 0x202..0x204
+  memory[0x200]     = 0xF3;
+  memory[0x200 + 1] = 0x33;
+  V[0x3] = 123;
+  I = 0x202;
+  pc = 0x200;
+  emulateCycle();
+
+  // 0x0203 is now at 0x203, which is not a valid instruction
+  pc = 0x203;
+  emulateCycle();
+  ASSERT_TRUE(illegalOpcode);
+  ASSERT_EQ(0x11, V[0xA]);
+}
+
+TEST_F(chip8Test, dirty_rows)
+{
+  // two rows drawn at the bottom, wrapping to the top, then erased again
+  memory[512]     = 0xD0;
+  memory[512 + 1] = 0x12;
+  memory[514]     = 0xD0;
+  memory[514 + 1] = 0x12;
+  memory[516]     = 0x00;
+  memory[516 + 1] = 0xE0;
+
+  I = 0xA30;
+  memory[0xA30]     = 0x80;
+  memory[0xA30 + 1] = 0x80;
+  V[0x1] = 31;
+
+  // everything is dirty after a reset, but nothing differs yet
+  ASSERT_EQ(0u, takeDirtyRows());
+
+  emulateCycle();
+  ASSERT_EQ((1u << 31) | (1u << 0), takeDirtyRows());
+  ASSERT_EQ(0u, takeDirtyRows());
+
+  // erasing it changes the same rows back
+  emulateCycle();
+  ASSERT_EQ((1u << 31) | (1u << 0), takeDirtyRows());
+
+  // clearing a blank screen changes nothing
+  emulateCycle();
+  ASSERT_EQ(0u, takeDirtyRows());
+}
+
+TEST_F(chip8Test, dirty_rows_draw_and_erase)
+{
+  // the same sprite drawn twice between two looks at the screen
+  memory[512]     = 0xD0;
+  memory[512 + 1] = 0x13;
+  memory[514]     = 0xD0;
+  memory[514 + 1] = 0x13;
+
+  I = 0xA30;
+  memory[0xA30]     = 0xFF;
+  memory[0xA30 + 2] = 0x01;
+  V[0x1] = 4;
+
+  takeDirtyRows();
+  emulateCycle();
+  emulateCycle();
+
+  ASSERT_EQ(0u, takeDirtyRows());
+}
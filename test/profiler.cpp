@@ -0,0 +1,132 @@
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "chip8.h"
+#include "profiler.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// 0x200: call 0x206 twice, then loop on 0x204
+// 0x206: call 0x20C, return
+// 0x20C: V0 = 1, return
+const std::vector<std::uint8_t> nested = {
+  0x22, 0x06, 0x22, 0x06, 0x12, 0x04, 0x22, 0x0C, 0x00, 0xEE, 0x00, 0x00,
+  0x60, 0x01, 0x00, 0xEE
+};
+
+}
+
+class profilerTest : public ::testing::TestWithParam<chip8::Engine>
+{
+protected:
+  void SetUp() override
+  {
+    supported = emu.setEngine(GetParam());
+    emu.loadGame(nested.data(), nested.size());
+  }
+
+  chip8 emu;
+  Profiler profiler;
+  bool supported;
+};
+
+TEST_P(profilerTest, follows_calls)
+{
+  if (!supported) return;
+
+  emu.setProfiler(&profiler);
+  EXPECT_EQ(12u, emu.runCycles(12, chip8::EVENT_NONE).cycles);
+  EXPECT_EQ(12u, profiler.instructions());
+
+  std::ostringstream pcs;
+  profiler.write(pcs);
+  EXPECT_EQ(
+    "main;pc_200 1\n"
+    "main;pc_202 1\n"
+    "main;pc_204 2\n"
+    "main;sub_206;pc_206 2\n"
+    "main;sub_206;pc_208 2\n"
+    "main;sub_206;sub_20c;pc_20c 2\n"
+    "main;sub_206;sub_20c;pc_20e 2\n", pcs.str());
+
+  std::ostringstream subroutines;
+  profiler.write(subroutines, false);
+  EXPECT_EQ(
+    "main 4\n"
+    "main;sub_206 4\n"
+    "main;sub_206;sub_20c 4\n", subroutines.str());
+}
+
+TEST_P(profilerTest, hotspots)
+{
+  if (!supported) return;
+
+  emu.setProfiler(&profiler);
+  emu.runCycles(20, chip8::EVENT_NONE);
+
+  auto spots = profiler.hotspots();
+  ASSERT_EQ(7u, spots.size());
+  EXPECT_EQ(0x204, spots[0].first);
+  EXPECT_EQ(10u, spots[0].second);
+  EXPECT_EQ(1u, spots.back().second);
+}
+
+TEST_P(profilerTest, detaches)
+{
+  if (!supported) return;
+
+  emu.setProfiler(&profiler);
+  emu.runCycles(5, chip8::EVENT_NONE);
+  emu.setProfiler(nullptr);
+  emu.runCycles(5, chip8::EVENT_NONE);
+  EXPECT_EQ(5u, profiler.instructions());
+
+  profiler.clear();
+  EXPECT_EQ(0u, profiler.instructions());
+  EXPECT_TRUE(profiler.hotspots().empty());
+}
+
+TEST_P(profilerTest, does_not_change_the_run)
+{
+  if (!supported) return;
+
+  std::ifstream file(std::string(GAMES_DIR) + "tetris.c8", std::ios::binary);
+  std::vector<std::uint8_t> rom((std::istreambuf_iterator<char>(file)),
+    std::istreambuf_iterator<char>());
+
+  chip8 reference;
+  reference.loadGame(rom.data(), rom.size());
+  reference.runCycles(50000, chip8::EVENT_NONE);
+
+  emu.loadGame(rom.data(), rom.size());
+  emu.setProfiler(&profiler);
+  emu.runCycles(50000, chip8::EVENT_NONE);
+
+  EXPECT_EQ(reference.stateHash(), emu.stateHash());
+  EXPECT_EQ(50000u, profiler.instructions());
+}
+
+INSTANTIATE_TEST_CASE_P(engines, profilerTest,
+  ::testing::Values(chip8::Engine::Interpreter, chip8::Engine::Jit));
+
+// a RET with an empty stack leaves sp at 0xFFFF, which must not be taken
+// for 65535 nested calls
+TEST(profilerDepthTest, ignores_wrapped_stack)
+{
+  Profiler profiler;
+  profiler.record(0x200, 0xFFFF, 0x202);
+  profiler.record(0x202, 0xFFFF, 0x204);
+  profiler.record(0x204, 0, 0x206);
+
+  std::ostringstream pcs;
+  profiler.write(pcs);
+  EXPECT_EQ(
+    "main;pc_200 1\n"
+    "main;pc_202 1\n"
+    "main;pc_204 1\n", pcs.str());
+}
@@ -0,0 +1,112 @@
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "chip8.h"
+#include "rewind.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// the states of the first frames of a game, with some input
+std::vector<chip8::SaveState> record(int frames)
+{
+  chip8 emu;
+  EXPECT_TRUE(emu.loadGame(std::string(GAMES_DIR) + "invaders.c8"));
+
+  std::vector<chip8::SaveState> states(frames);
+  for (int i = 0; i < frames; i++) {
+    std::array<std::uint8_t, 16> keys{{}};
+    keys[(i / 30) % 16] = (i % 60) < 30;
+    emu.setKeys(keys);
+    emu.runUntilFrame(chip8::EVENT_NONE);
+    emu.saveState(states[i]);
+  }
+
+  return states;
+}
+
+bool same(const chip8::SaveState& a, const chip8::SaveState& b)
+{
+  return std::memcmp(&a, &b, sizeof(chip8::SaveState)) == 0;
+}
+
+}
+
+TEST(rewindTest, steps_back_through_every_state)
+{
+  std::vector<chip8::SaveState> states = record(600);
+
+  Rewind rewind;
+  for (auto& state : states)
+    rewind.push(state);
+  ASSERT_EQ(states.size(), rewind.size());
+
+  chip8::SaveState state;
+  for (int i = states.size() - 1; i >= 0; i--) {
+    ASSERT_TRUE(rewind.pop(state));
+    ASSERT_TRUE(same(states[i], state)) << "frame " << i;
+  }
+  EXPECT_FALSE(rewind.pop(state));
+  EXPECT_EQ(0u, rewind.memoryUsed());
+}
+
+TEST(rewindTest, push_after_pop)
+{
+  std::vector<chip8::SaveState> states = record(300);
+
+  // rewind into the middle of a keyframe group and record again from there
+  Rewind rewind(1 << 20, 50);
+  for (int i = 0; i < 200; i++)
+    rewind.push(states[i]);
+
+  chip8::SaveState state;
+  for (int i = 0; i < 75; i++)
+    rewind.pop(state);
+  for (int i = 125; i < 300; i++)
+    rewind.push(states[i]);
+
+  for (int i = 299; i >= 125; i--) {
+    ASSERT_TRUE(rewind.pop(state));
+    ASSERT_TRUE(same(states[i], state)) << "frame " << i;
+  }
+  for (int i = 124; i >= 0; i--) {
+    ASSERT_TRUE(rewind.pop(state));
+    ASSERT_TRUE(same(states[i], state)) << "frame " << i;
+  }
+}
+
+TEST(rewindTest, compresses)
+{
+  std::vector<chip8::SaveState> states = record(600);
+
+  Rewind rewind;
+  for (auto& state : states)
+    rewind.push(state);
+
+  // far below a full copy per frame
+  EXPECT_LT(rewind.memoryUsed(),
+    states.size() * sizeof(chip8::SaveState) / 20);
+}
+
+TEST(rewindTest, stays_within_budget)
+{
+  std::vector<chip8::SaveState> states = record(600);
+
+  const std::size_t budget = 16 * 1024;
+  Rewind rewind(budget, 30);
+  for (auto& state : states) {
+    rewind.push(state);
+    ASSERT_LE(rewind.memoryUsed(), budget);
+  }
+
+  // the newest states are kept
+  ASSERT_LT(rewind.size(), states.size());
+  chip8::SaveState state;
+  std::size_t kept = rewind.size();
+  for (std::size_t i = 0; i < kept; i++) {
+    ASSERT_TRUE(rewind.pop(state));
+    ASSERT_TRUE(same(states[states.size() - 1 - i], state));
+  }
+}
@@ -0,0 +1,159 @@
+#include <cstdint>
+#include <vector>
+
+#include "chip8.h"
+#include "gtest/gtest.h"
+
+class runTest : public ::testing::TestWithParam<chip8::Engine>, protected chip8
+{
+protected:
+  void SetUp() override
+  {
+    supported = setEngine(GetParam());
+  }
+
+  void load(const std::vector<std::uint8_t>& program)
+  {
+    std::copy(program.begin(), program.end(), memory.begin() + 512);
+  }
+
+  bool supported;
+};
+
+TEST_P(runTest, runs_all_cycles)
+{
+  if (!supported) return;
+
+  // V0 += 1, jump back
+  load({0x70, 0x01, 0x12, 0x00});
+
+  // only frame ends happen, which do not stop the run by default
+  RunResult result = runCycles(1000);
+  EXPECT_EQ(1000u, result.cycles);
+  EXPECT_EQ(EVENT_FRAME, result.events);
+  EXPECT_EQ(500 % 256, V[0x0]);
+
+  result = runCycles(1000, EVENT_ALL);
+  EXPECT_EQ(10u, result.cycles);
+}
+
+TEST_P(runTest, stops_on_draw)
+{
+  if (!supported) return;
+
+  // V0 += 1, V0 += 1, draw, jump back
+  load({0x70, 0x01, 0x70, 0x01, 0xD0, 0x01, 0x12, 0x00});
+
+  RunResult result = runCycles(1000, EVENT_DRAW);
+  EXPECT_EQ(3u, result.cycles);
+  EXPECT_EQ(EVENT_DRAW, result.events);
+  EXPECT_EQ(0x206, pc);
+
+  result = runCycles(1000, EVENT_DRAW);
+  EXPECT_EQ(4u, result.cycles);
+  EXPECT_EQ(EVENT_DRAW, result.events);
+
+  // the frame ends on the 10th cycle, which is reported without stopping
+  result = runCycles(1000, EVENT_DRAW);
+  EXPECT_EQ(4u, result.cycles);
+  EXPECT_EQ(EVENT_DRAW | EVENT_FRAME, result.events);
+}
+
+TEST_P(runTest, stops_on_sound_start_and_stop)
+{
+  if (!supported) return;
+
+  // V0 = 5, sound_timer = V0, sound_timer = V0, sound_timer = V1,
+  // sound_timer = V1
+  load({0x60, 0x05, 0xF0, 0x18, 0xF0, 0x18, 0xF1, 0x18, 0xF1, 0x18});
+
+  RunResult result = runCycles(1000, EVENT_SOUND);
+  EXPECT_EQ(2u, result.cycles);
+  EXPECT_EQ(EVENT_SOUND, result.events);
+
+  // restarting a running timer changes nothing that can be heard
+  result = runCycles(1, EVENT_SOUND);
+  EXPECT_EQ(EVENT_NONE, result.events);
+
+  // clearing it does
+  result = runCycles(1000, EVENT_SOUND);
+  EXPECT_EQ(1u, result.cycles);
+  EXPECT_EQ(EVENT_SOUND, result.events);
+
+  // and clearing a stopped one does not
+  result = runCycles(1, EVENT_SOUND);
+  EXPECT_EQ(EVENT_NONE, result.events);
+}
+
+TEST_P(runTest, stops_on_key_wait)
+{
+  if (!supported) return;
+
+  // V0 = 1, wait for key
+  load({0x60, 0x01, 0xF1, 0x0A});
+
+  RunResult result = runCycles(1000);
+  EXPECT_EQ(2u, result.cycles);
+  EXPECT_EQ(EVENT_KEYWAIT, result.events);
+  EXPECT_EQ(0x202, pc);
+}
+
+TEST_P(runTest, stops_on_illegal_opcode)
+{
+  if (!supported) return;
+
+  load({0x60, 0x01, 0xFF, 0xFF});
+
+  RunResult result = runCycles(1000);
+  EXPECT_EQ(2u, result.cycles);
+  EXPECT_EQ(EVENT_ILLEGAL, result.events);
+  EXPECT_TRUE(illegalOpcode);
+}
+
+TEST_P(runTest, runs_until_frame)
+{
+  if (!supported) return;
+
+  // V0 += 1, jump back
+  load({0x70, 0x01, 0x12, 0x00});
+
+  runCycles(3, EVENT_NONE);
+
+  // finishes the frame that was started
+  RunResult result = runUntilFrame();
+  EXPECT_EQ(7u, result.cycles);
+  EXPECT_EQ(EVENT_FRAME, result.events);
+
+  result = runUntilFrame();
+  EXPECT_EQ(10u, result.cycles);
+}
+
+TEST_P(runTest, timers_tick_once_per_frame)
+{
+  if (!supported) return;
+
+  // V0 = 5, delay_timer = V0, sound_timer = V0, V0 += 1, jump back
+  load({0x60, 0x05, 0xF0, 0x15, 0xF0, 0x18, 0x70, 0x01, 0x12, 0x06});
+
+  runUntilFrame(EVENT_NONE);
+  EXPECT_EQ(4, delay_timer);
+  EXPECT_EQ(4, sound_timer);
+
+  // the instruction rate doesn't change how fast the timers run
+  setCyclesPerFrame(1000);
+  EXPECT_EQ(1000u, getCyclesPerFrame());
+
+  runCycles(999, EVENT_NONE);
+  EXPECT_EQ(4, delay_timer);
+
+  runCycles(1, EVENT_NONE);
+  EXPECT_EQ(3, delay_timer);
+  EXPECT_EQ(3, sound_timer);
+
+  runCycles(3000, EVENT_NONE);
+  EXPECT_EQ(0, delay_timer);
+  EXPECT_EQ(0, sound_timer);
+}
+
+INSTANTIATE_TEST_CASE_P(engines, runTest,
+  ::testing::Values(chip8::Engine::Interpreter, chip8::Engine::Jit));
@@ -0,0 +1,120 @@
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "chip8.h"
+#include "gtest/gtest.h"
+
+class saveStateTest : public ::testing::Test, protected chip8
+{
+protected:
+  void SetUp() override
+  {
+    ASSERT_TRUE(loadGame(std::string(GAMES_DIR) + "tetris.c8"));
+  }
+
+  std::uint64_t run(unsigned long cycles)
+  {
+    runCycles(cycles, EVENT_NONE);
+    return stateHash();
+  }
+};
+
+TEST_F(saveStateTest, round_trip)
+{
+  run(5000);
+
+  SaveState state;
+  saveState(state);
+  std::uint64_t saved = stateHash();
+  std::uint64_t expected = run(20000);
+
+  ASSERT_TRUE(loadState(state));
+  EXPECT_EQ(saved, stateHash());
+  EXPECT_EQ(expected, run(20000));
+}
+
+TEST_F(saveStateTest, byte_stable)
+{
+  run(5000);
+
+  // garbage in the destination must not leak into the snapshot
+  SaveState a;
+  SaveState b;
+  std::memset(&a, 0x00, sizeof(a));
+  std::memset(&b, 0xFF, sizeof(b));
+  saveState(a);
+  saveState(b);
+
+  EXPECT_EQ(0, std::memcmp(&a, &b, sizeof(SaveState)));
+  EXPECT_EQ(0, std::memcmp(a.magic.data(), "SC8E", 4));
+  EXPECT_EQ(SaveState::VERSION, a.version);
+}
+
+TEST_F(saveStateTest, rejects_other_formats)
+{
+  SaveState state;
+  saveState(state);
+  run(1000);
+  std::uint64_t hash = stateHash();
+
+  SaveState bad = state;
+  bad.magic[0] = 'X';
+  EXPECT_FALSE(loadState(bad));
+
+  bad = state;
+  bad.version = SaveState::VERSION + 1;
+  EXPECT_FALSE(loadState(bad));
+
+  // nothing was touched
+  EXPECT_EQ(hash, stateHash());
+}
+
+TEST_F(saveStateTest, round_trips_registers_past_the_end)
+{
+  // I = 0xFFF + 0x10, then an unmatched RET underflows sp
+  const std::uint8_t rom[] = {0xAF, 0xFF, 0x60, 0x10, 0xF0, 0x1E, 0x00, 0xEE};
+  ASSERT_TRUE(loadGame(rom, sizeof(rom)));
+  run(4);
+  ASSERT_EQ(0x100F, I);
+  ASSERT_EQ(0xFFFF, sp);
+
+  SaveState state;
+  saveState(state);
+  std::uint64_t saved = stateHash();
+  std::uint64_t expected = run(100);
+
+  ASSERT_TRUE(loadState(state));
+  EXPECT_EQ(saved, stateHash());
+  EXPECT_EQ(expected, run(100));
+
+  // and values at the very end of the address space
+  state.pc = 0xFFFF;
+  state.stack.fill(0xFFFF);
+  ASSERT_TRUE(loadState(state));
+  run(100);
+}
+
+TEST_F(saveStateTest, restores_code)
+{
+  // V0 += 1
+  memory[0x300]     = 0x70;
+  memory[0x300 + 1] = 0x01;
+  pc = 0x300;
+
+  SaveState state;
+  saveState(state);
+
+  // run the instruction, then overwrite it with V0 += 2
+  emulateCycle();
+  memory[0x300 + 1] = 0x02;
+  invalidate(0x301, 1);
+  pc = 0x300;
+  emulateCycle();
+  ASSERT_EQ(3, V[0x0]);
+
+  // the restored code runs, not the one decoded last
+  ASSERT_TRUE(loadState(state));
+  emulateCycle();
+  EXPECT_EQ(1, V[0x0]);
+}
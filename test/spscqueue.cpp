@@ -0,0 +1,78 @@
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "spscqueue.h"
+#include "squarewave.h"
+#include "gtest/gtest.h"
+
+TEST(spscQueueTest, fills_and_drains)
+{
+  SpscQueue<int, 8> queue;
+  int value = 0;
+  ASSERT_FALSE(queue.pop(value));
+
+  std::vector<int> values = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  EXPECT_EQ(8u, queue.push(values.data(), values.size()));
+  EXPECT_EQ(8u, queue.size());
+  EXPECT_FALSE(queue.push(11));
+
+  std::vector<int> out(5);
+  ASSERT_EQ(5u, queue.pop(out.data(), out.size()));
+  EXPECT_EQ(std::vector<int>({1, 2, 3, 4, 5}), out);
+
+  // wraps around the end of the buffer
+  EXPECT_EQ(2u, queue.push(values.data() + 8, 2));
+  out.resize(8);
+  ASSERT_EQ(5u, queue.pop(out.data(), out.size()));
+  out.resize(5);
+  EXPECT_EQ(std::vector<int>({6, 7, 8, 9, 10}), out);
+  EXPECT_EQ(0u, queue.size());
+}
+
+TEST(spscQueueTest, threads)
+{
+  SpscQueue<std::uint32_t, 64> queue;
+  const std::uint32_t count = 200000;
+
+  std::thread producer([&]() {
+    for (std::uint32_t i = 0; i < count; ) {
+      std::uint32_t block[7];
+      std::size_t n = 0;
+      for (; n < 7 && i + n < count; n++)
+        block[n] = i + n;
+      i += queue.push(block, n);
+    }
+  });
+
+  // every value arrives exactly once and in order
+  std::uint32_t expected = 0;
+  while (expected < count) {
+    std::uint32_t block[5];
+    std::size_t n = queue.pop(block, 5);
+    for (std::size_t i = 0; i < n; i++)
+      ASSERT_EQ(expected++, block[i]);
+  }
+
+  producer.join();
+  EXPECT_EQ(0u, queue.size());
+}
+
+TEST(squareWaveTest, keeps_phase)
+{
+  // 4 samples per period
+  SquareWave wave(400, 100, 1000);
+  std::int16_t out[6];
+
+  wave.generate(true, out, 3);
+  wave.generate(true, out + 3, 3);
+  std::vector<std::int16_t> expected = {1000, 1000, -1000, -1000, 1000, 1000};
+  EXPECT_EQ(expected, std::vector<std::int16_t>(out, out + 6));
+
+  // silence keeps the phase running
+  wave.generate(false, out, 2);
+  EXPECT_EQ(0, out[0]);
+  EXPECT_EQ(0, out[1]);
+  wave.generate(true, out, 1);
+  EXPECT_EQ(1000, out[0]);
+}
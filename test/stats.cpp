@@ -0,0 +1,80 @@
+#include <cstdint>
+#include <vector>
+
+#include "chip8.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// indices into chip8::handlerNames
+enum Handler { RET = 1, JP_A = 2, CALL = 3, SE_VB = 4, LD_VB = 7, ADD_VB = 8,
+               DRW = 22 };
+
+}
+
+class statsTest : public ::testing::TestWithParam<chip8::Engine>
+{
+protected:
+  void SetUp() override
+  {
+    supported = emu.setEngine(GetParam());
+  }
+
+  chip8 emu;
+  bool supported;
+};
+
+TEST_P(statsTest, names_match_handlers)
+{
+  EXPECT_STREQ("CLS", chip8::handlerNames[0]);
+  EXPECT_STREQ("CALL", chip8::handlerNames[CALL]);
+  EXPECT_STREQ("DRW", chip8::handlerNames[DRW]);
+  EXPECT_STREQ("ILLEGAL", chip8::handlerNames[chip8::HANDLERS - 1]);
+}
+
+TEST_P(statsTest, counts_every_handler)
+{
+  if (!supported) return;
+
+  // 0x200: V0 = 0, call 0x20A, V0 += 1, skip if V0 == 5, jump 0x202
+  // 0x20A: draw, return
+  std::vector<std::uint8_t> rom = {
+    0x60, 0x00, 0x22, 0x0A, 0x70, 0x01, 0x30, 0x05, 0x12, 0x02,
+    0xD0, 0x01, 0x00, 0xEE
+  };
+  ASSERT_TRUE(emu.loadGame(rom.data(), rom.size()));
+
+  // five times round the loop, then stop in front of the jump past it
+  emu.runCycles(1 + 5 * 6 - 1, chip8::EVENT_NONE);
+
+  const chip8::Stats& stats = emu.getStats();
+  if (!chip8::statsEnabled) {
+    for (std::uint64_t count : stats.executed)
+      EXPECT_EQ(0u, count);
+    EXPECT_EQ(0u, stats.drawNanoseconds);
+    return;
+  }
+
+  EXPECT_EQ(1u, stats.executed[LD_VB]);
+  EXPECT_EQ(5u, stats.executed[CALL]);
+  EXPECT_EQ(5u, stats.executed[DRW]);
+  EXPECT_EQ(5u, stats.executed[RET]);
+  EXPECT_EQ(5u, stats.executed[ADD_VB]);
+  EXPECT_EQ(5u, stats.executed[SE_VB]);
+  EXPECT_EQ(4u, stats.executed[JP_A]);
+
+  std::uint64_t total = 0;
+  for (std::uint64_t count : stats.executed)
+    total += count;
+  EXPECT_EQ(30u, total);
+
+  // counters survive a reset, until cleared
+  emu.reset();
+  EXPECT_EQ(5u, emu.getStats().executed[CALL]);
+  emu.resetStats();
+  EXPECT_EQ(0u, emu.getStats().executed[CALL]);
+  EXPECT_EQ(0u, emu.getStats().drawNanoseconds);
+}
+
+INSTANTIATE_TEST_CASE_P(engines, statsTest,
+  ::testing::Values(chip8::Engine::Interpreter, chip8::Engine::Jit));
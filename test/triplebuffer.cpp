@@ -0,0 +1,68 @@
+#include <array>
+#include <cstdint>
+#include <thread>
+
+#include "triplebuffer.h"
+#include "gtest/gtest.h"
+
+TEST(tripleBufferTest, newest_value_wins)
+{
+  TripleBuffer<int> buffer;
+
+  // nothing published yet
+  ASSERT_FALSE(buffer.update());
+  ASSERT_FALSE(buffer.pending());
+
+  buffer.back() = 1;
+  ASSERT_FALSE(buffer.publish());
+  buffer.back() = 2;
+
+  // the first value was never picked up
+  ASSERT_TRUE(buffer.publish());
+  ASSERT_TRUE(buffer.pending());
+
+  ASSERT_TRUE(buffer.update());
+  ASSERT_FALSE(buffer.pending());
+  ASSERT_EQ(2, buffer.front());
+
+  // no new value, front stays the same
+  ASSERT_FALSE(buffer.update());
+  ASSERT_EQ(2, buffer.front());
+
+  buffer.back() = 3;
+  ASSERT_FALSE(buffer.publish());
+  ASSERT_TRUE(buffer.update());
+  ASSERT_EQ(3, buffer.front());
+}
+
+TEST(tripleBufferTest, concurrent_handoff)
+{
+  // every element of a frame holds the frame number, a torn frame would
+  // show up as a mix of numbers
+  typedef std::array<std::uint32_t, 64> Frame;
+  TripleBuffer<Frame> buffer;
+  const std::uint32_t frames = 200000;
+
+  std::thread producer([&]() {
+    for (std::uint32_t i = 1; i <= frames; ++i) {
+      buffer.back().fill(i);
+      buffer.publish();
+    }
+  });
+
+  std::uint32_t last = 0;
+  while (last != frames) {
+    if (!buffer.update())
+      continue;
+
+    const Frame& frame = buffer.front();
+    for (std::uint32_t value : frame)
+      ASSERT_EQ(frame[0], value);
+
+    // frames may be skipped, but never go backwards
+    ASSERT_GT(frame[0], last);
+    last = frame[0];
+  }
+
+  producer.join();
+}